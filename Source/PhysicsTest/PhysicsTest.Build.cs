@@ -13,6 +13,9 @@ public class PhysicsTest : ModuleRules
 
         PrivateDependencyModuleNames.AddRange(new string[] { "PhysicsCore","GeometryScriptingCore", "ModelingOperators" });
 
+        // 体素砖块内核（VoxelKernels.ispc），不支持 ISPC 的平台使用标量实现
+        PrivateDependencyModuleNames.Add("IntelISPC");
+
         // Uncomment if you are using Slate UI
         // PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
 
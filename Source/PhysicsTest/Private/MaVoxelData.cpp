@@ -2,409 +2,1582 @@
 
 #include "DynamicMesh/MeshTransforms.h"
 #include "Spatial/FastWinding.h"
+#include "Distance/DistPoint3Triangle3.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Sort.h"
+#include "VoxelKernels.h"
 
-UE_DISABLE_OPTIMIZATION
 using namespace UE::Geometry;
 
-void FOctreeNode::Subdivide(double MinVoxelSize)
-{
-	if (!bIsLeaf) return;
-    
-	FVector3d Center = Bounds.Center();
-    FVector3d Size = Bounds.Max - Bounds.Min;
-    
-	// 如果节点尺寸已经小于最小体素尺寸，不进行细分
-	if (Size.X < MinVoxelSize  && Size.Y < MinVoxelSize  && Size.Z < MinVoxelSize )
-	{
-		return;
-	}
-    
-	Children.SetNum(8);
-    
-	for (int32 i = 0; i < 8; i++)
-	{
-		FVector3d ChildMin;
-		FVector3d ChildMax;
-        
-		if (i & 1)
-		{
-		    ChildMin.X = Center.X;
-		    ChildMax.X = Bounds.Max.X;
-		}	        
-	    else
-	    {
-	        ChildMin.X = Bounds.Min.X;
-	        ChildMax.X = Center.X;	        
-	    }
-		if (i & 2)
-		{
-		    ChildMin.Y = Center.Y;
-		    ChildMax.Y = Bounds.Max.Y;
-		}
-	    else
-	    {
-	        ChildMin.Y = Bounds.Min.Y;
-	        ChildMax.Y = Center.Y;
-	    }
-		if (i & 4)
-		{
-		    ChildMin.Z = Center.Z;
-		    ChildMax.Z = Bounds.Max.Z;
-		}
-	    else
-	    {
-	        ChildMin.Z = Bounds.Min.Z;
-	        ChildMax.Z = Center.Z;
-	    }
-
-	    // 添加边界验证
-	    if (ChildMin.X >= ChildMax.X || ChildMin.Y >= ChildMax.Y || ChildMin.Z >= ChildMax.Z)
-	    {
-	        UE_LOG(LogTemp, Error, TEXT("无效的子节点边界[%d]: Min(%s), Max(%s)"), 
-                   i, *ChildMin.ToString(), *ChildMax.ToString());
-	        // 使用安全的边界
-	        ChildMin = Bounds.Min;
-	        ChildMax = Bounds.Max;
-	    }
-        
-		Children[i].Bounds = FAxisAlignedBox3d(ChildMin, ChildMax);
-		Children[i].Depth = Depth + 1;
-		Children[i].bIsLeaf = true;
-		Children[i].bIsEmpty = true;
-	}
-    
-	bIsLeaf = false;
-	Voxels.Empty(); // 非叶子节点不存储具体体素数据
-}
-
-bool FOctreeNode::ContainsPoint(const FVector3d& Point) const
-{
-	return Bounds.Contains(Point);
-}
-
-bool FOctreeNode::IntersectsBounds(const FAxisAlignedBox3d& OtherBounds) const
-{
-	return Bounds.Intersects(OtherBounds);
-}
-
-void FMaVoxelData::Reset()
-{
-	OctreeRoot = FOctreeNode();
-}
-
-void FMaVoxelData::BuildOctreeFromMesh(const FDynamicMesh3& Mesh, const FTransform& Transform)
-{
-	if (Mesh.TriangleCount() == 0) 
+namespace
+{
+    // 三线性插值（8个角点按 X 最快、Z 最慢排列）
+    float TrilinearInterpolate(const float Corners[8], double u, double v, double w)
+    {
+        float x00 = FMath::Lerp(Corners[0], Corners[1], u);
+        float x10 = FMath::Lerp(Corners[2], Corners[3], u);
+        float x01 = FMath::Lerp(Corners[4], Corners[5], u);
+        float x11 = FMath::Lerp(Corners[6], Corners[7], u);
+
+        float y0 = FMath::Lerp(x00, x10, v);
+        float y1 = FMath::Lerp(x01, x11, v);
+
+        return FMath::Lerp(y0, y1, w);
+    }
+
+    // 二维边函数。按固定的顶点顺序计算，保证共享边在相邻两个三角形中得到严格相反的值
+    double EdgeFunction(const FVector2d& A, const FVector2d& B, const FVector2d& Q)
+    {
+        bool bSwap = (A.X > B.X) || (A.X == B.X && A.Y > B.Y);
+        const FVector2d& P0 = bSwap ? B : A;
+        const FVector2d& P1 = bSwap ? A : B;
+        double E = (P1.X - P0.X) * (Q.Y - P0.Y) - (P1.Y - P0.Y) * (Q.X - P0.X);
+        return bSwap ? -E : E;
+    }
+
+    // 点恰好落在边上时的归属规则：共享边只算给其中一个三角形
+    bool IsOwnedEdge(const FVector2d& A, const FVector2d& B)
+    {
+        return (B.Y > A.Y) || (B.Y == A.Y && B.X < A.X);
+    }
+
+    // 量化一个砖块：距离截断到 [-Band, Band]，按砖块内的最大绝对值确定步长，返回步长
+    template<typename CodeType>
+    float QuantizeBrick(const float* Values, float Band, CodeType* OutCodes)
+    {
+        constexpr int32 MaxCode = TNumericLimits<CodeType>::Max();
+        float MinValue, MaxValue;
+        VoxelKernels::BrickMinMax(Values, FMaVoxelData::BrickVoxelCount, MinValue, MaxValue);
+        float MaxAbs = FMath::Min(FMath::Max(FMath::Abs(MinValue), FMath::Abs(MaxValue)), Band);
+        float Scale = FMath::Max(MaxAbs, UE_SMALL_NUMBER) / (float)MaxCode;
+        float InvScale = 1.0f / Scale;
+
+        for (int32 i = 0; i < FMaVoxelData::BrickVoxelCount; i++)
+        {
+            float Value = FMath::Clamp(Values[i], -Band, Band);
+            int32 Code = FMath::Clamp(FMath::RoundToInt32(Value * InvScale), -MaxCode, MaxCode);
+            // 贴近表面的负值至少保留一个步长，保证内外符号不被量化改变
+            if (Value < 0.0f && Code == 0)
+            {
+                Code = -1;
+            }
+            OutCodes[i] = (CodeType)Code;
+        }
+        return Scale;
+    }
+
+    template<typename CodeType>
+    void DequantizeBrick(const CodeType* Codes, float Scale, float* OutValues)
+    {
+        for (int32 i = 0; i < FMaVoxelData::BrickVoxelCount; i++)
+        {
+            OutValues[i] = (float)Codes[i] * Scale;
+        }
+    }
+
+    // 取出单元的 8 个角点（同一砖块内），解码与三线性插值的取数合并在一起
+    template<typename CodeType>
+    void GatherCellCorners(const CodeType* Voxels, int32 Base, float Scale, float Corners[8])
+    {
+        constexpr int32 StrideY = FMaVoxelData::BrickSize;
+        constexpr int32 StrideZ = FMaVoxelData::BrickSize * FMaVoxelData::BrickSize;
+        Corners[0] = (float)Voxels[Base] * Scale;
+        Corners[1] = (float)Voxels[Base + 1] * Scale;
+        Corners[2] = (float)Voxels[Base + StrideY] * Scale;
+        Corners[3] = (float)Voxels[Base + StrideY + 1] * Scale;
+        Corners[4] = (float)Voxels[Base + StrideZ] * Scale;
+        Corners[5] = (float)Voxels[Base + StrideZ + 1] * Scale;
+        Corners[6] = (float)Voxels[Base + StrideZ + StrideY] * Scale;
+        Corners[7] = (float)Voxels[Base + StrideZ + StrideY + 1] * Scale;
+    }
+}
+
+const FIntVector FMaVoxelData::FreeSlotCoord(INDEX_NONE, INDEX_NONE, INDEX_NONE);
+
+void FMaVoxelData::Reset(bool bReleaseMemory)
+{
+    Bounds = FAxisAlignedBox3d::Empty();
+    VoxelSize = 0.0;
+    BrickDims = FIntVector::ZeroValue;
+    Parent.Reset();
+    RefineFactor = 1;
+    if (bReleaseMemory)
+    {
+        BrickTable.Empty();
+        BrickPool.Empty();
+        BrickScales.Empty();
+        BrickCoords.Empty();
+        FreeBrickSlots.Empty();
+    }
+    else
+    {
+        BrickTable.Reset();
+        BrickPool.Reset();
+        BrickScales.Reset();
+        BrickCoords.Reset();
+        FreeBrickSlots.Reset();
+    }
+}
+
+void FMaVoxelData::ReserveBricks(int32 NumBricks)
+{
+    int32 NewSlots = FMath::Max(NumBricks - FreeBrickSlots.Num(), 0);
+    if (NewSlots == 0) return;
+
+    BrickCoords.Reserve(BrickCoords.Num() + NewSlots);
+    BrickPool.Reserve(BrickPool.Num() + NewSlots * GetBrickStride());
+    if (IsQuantized())
+    {
+        BrickScales.Reserve(BrickScales.Num() + NewSlots);
+    }
+}
+
+void FMaVoxelData::FreeBrick(const FIntVector& BrickCoord, float UniformValue)
+{
+    FVoxelBrickCell& Cell = BrickTable[GetBrickLinearIndex(BrickCoord)];
+    if (Cell.IsAllocated())
+    {
+        BrickCoords[Cell.PoolIndex] = FreeSlotCoord;
+        FreeBrickSlots.Add(Cell.PoolIndex);
+        Cell.PoolIndex = INDEX_NONE;
+    }
+    Cell.UniformValue = UniformValue;
+}
+
+void FMaVoxelData::CopyRegionFrom(const FMaVoxelData& Source, const FIntVector& BrickMin, const FIntVector& BrickMax)
+{
+    const bool bSameGrid = BrickDims == Source.BrickDims && BrickTable.Num() == Source.BrickTable.Num();
+
+    MarchingCubeSize = Source.MarchingCubeSize;
+    MaxOctreeDepth = Source.MaxOctreeDepth;
+    MinVoxelSize = Source.MinVoxelSize;
+    StorageFormat = Source.StorageFormat;
+    QuantizeBandVoxels = Source.QuantizeBandVoxels;
+    Bounds = Source.Bounds;
+    VoxelSize = Source.VoxelSize;
+    BrickDims = Source.BrickDims;
+    Parent = Source.Parent;
+    RefineFactor = Source.RefineFactor;
+
+    if (!bSameGrid)
+    {
+        // 网格尺寸改变（首次使用或重新初始化）时才整体建立索引表
+        BrickTable.Reset();
+        BrickTable.SetNum(Source.BrickTable.Num());
+    }
+    else
+    {
+        // 上次快照分配过的条目记录在 BrickCoords 中，只把这些条目置空，其余条目本来就不指向砖块池
+        for (const FIntVector& BrickCoord : BrickCoords)
+        {
+            BrickTable[GetBrickLinearIndex(BrickCoord)].PoolIndex = INDEX_NONE;
+        }
+    }
+    BrickPool.Reset();
+    BrickScales.Reset();
+    BrickCoords.Reset();
+    FreeBrickSlots.Reset();
+
+    const int64 BrickStride = GetBrickStride();
+    FIntVector Min(FMath::Max(BrickMin.X, 0), FMath::Max(BrickMin.Y, 0), FMath::Max(BrickMin.Z, 0));
+    FIntVector Max(FMath::Min(BrickMax.X, BrickDims.X - 1), FMath::Min(BrickMax.Y, BrickDims.Y - 1), FMath::Min(BrickMax.Z, BrickDims.Z - 1));
+    for (int32 Z = Min.Z; Z <= Max.Z; Z++)
+    {
+        for (int32 Y = Min.Y; Y <= Max.Y; Y++)
+        {
+            for (int32 X = Min.X; X <= Max.X; X++)
+            {
+                FIntVector BrickCoord(X, Y, Z);
+                const FVoxelBrickCell& SourceCell = Source.GetBrickCell(BrickCoord);
+                FVoxelBrickCell& Cell = BrickTable[GetBrickLinearIndex(BrickCoord)];
+                Cell.UniformValue = SourceCell.UniformValue;
+                if (!SourceCell.IsAllocated())
+                {
+                    Cell.PoolIndex = SourceCell.IsFromParent() ? FVoxelBrickCell::ParentPoolIndex : INDEX_NONE;
+                    continue;
+                }
+
+                Cell.PoolIndex = BrickCoords.Add(BrickCoord);
+                BrickPool.AddUninitialized(BrickStride);
+                FMemory::Memcpy(BrickPool.GetData() + Cell.PoolIndex * BrickStride, Source.BrickPool.GetData() + SourceCell.PoolIndex * BrickStride, BrickStride);
+                if (IsQuantized())
+                {
+                    BrickScales.Add(Source.BrickScales[SourceCell.PoolIndex]);
+                }
+            }
+        }
+    }
+}
+
+void FMaVoxelData::InitializeRefined(TSharedPtr<const FMaVoxelData, ESPMode::ThreadSafe> InParent, int32 InRefineFactor)
+{
+    check(InParent.IsValid() && InParent->IsValid() && InRefineFactor >= 1);
+    Reset();
+
+    MarchingCubeSize = InParent->MarchingCubeSize;
+    MaxOctreeDepth = InParent->MaxOctreeDepth;
+    MinVoxelSize = InParent->MinVoxelSize;
+    StorageFormat = InParent->StorageFormat;
+    QuantizeBandVoxels = InParent->QuantizeBandVoxels;
+
+    // 与父级同一原点，细网格的格点嵌套在父级单元内
+    RefineFactor = InRefineFactor;
+    VoxelSize = InParent->VoxelSize / RefineFactor;
+    BrickDims = InParent->BrickDims * RefineFactor;
+    FIntVector SampleDims = GetSampleDims();
+    Bounds = FAxisAlignedBox3d(InParent->Bounds.Min,
+        InParent->Bounds.Min + FVector3d(SampleDims.X - 1, SampleDims.Y - 1, SampleDims.Z - 1) * VoxelSize);
+
+    BrickTable.SetNum(BrickDims.X * BrickDims.Y * BrickDims.Z);
+    ParallelFor(BrickDims.Z, [&](int32 BZ)
+    {
+        for (int32 BY = 0; BY < BrickDims.Y; BY++)
+        {
+            for (int32 BX = 0; BX < BrickDims.X; BX++)
+            {
+                const FVoxelBrickCell& ParentCell = InParent->GetBrickCell(FIntVector(BX, BY, BZ) / RefineFactor);
+                FVoxelBrickCell& Cell = BrickTable[GetBrickLinearIndex(FIntVector(BX, BY, BZ))];
+                Cell.UniformValue = ParentCell.UniformValue;
+                if (ParentCell.IsAllocated() || ParentCell.IsFromParent())
+                {
+                    Cell.PoolIndex = FVoxelBrickCell::ParentPoolIndex;
+                }
+            }
+        }
+    });
+
+    Parent = MoveTemp(InParent);
+}
+
+void FMaVoxelData::ResampleFromParent(const FIntVector& BrickCoord, float* OutValues) const
+{
+    // 细格点落在父级单元内，父级的三线性插值即为细化后的初值
+    FVector3d Positions[BrickVoxelCount];
+    FIntVector Origin = BrickCoord * BrickSize;
+    for (int32 Z = 0; Z < BrickSize; Z++)
+    {
+        for (int32 Y = 0; Y < BrickSize; Y++)
+        {
+            for (int32 X = 0; X < BrickSize; X++)
+            {
+                Positions[GetLocalVoxelIndex(X, Y, Z)] = ClampToParentBounds(GetSamplePosition(Origin.X + X, Origin.Y + Y, Origin.Z + Z));
+            }
+        }
+    }
+    Parent->GetValuesAtPositions(TArrayView<const FVector3d>(Positions, BrickVoxelCount), TArrayView<float>(OutValues, BrickVoxelCount));
+}
+
+void FMaVoxelData::InitializeBrickGrid(const FAxisAlignedBox3d& WorldBounds)
+{
+    Reset();
+
+    // 设置根边界（稍微扩展）
+    FVector3d ExpandedMin = WorldBounds.Min - FVector3d(2.0 * MarchingCubeSize);
+    FVector3d ExpandedMax = WorldBounds.Max + FVector3d(2.0 * MarchingCubeSize);
+    FVector3d RootSize = ExpandedMax - ExpandedMin;
+
+    // 砖块尺寸相当于原八叉树在最大深度处的叶子尺寸，体素间距不小于最小体素大小
+    double LeafSize = RootSize.GetMax() / (double)(1 << FMath::Clamp(MaxOctreeDepth, 0, 20));
+    VoxelSize = FMath::Max(MinVoxelSize, LeafSize / BrickSize);
+
+    const double BrickWorldSize = VoxelSize * BrickSize;
+    BrickDims = FIntVector(
+        FMath::Max(1, FMath::CeilToInt32(RootSize.X / BrickWorldSize)),
+        FMath::Max(1, FMath::CeilToInt32(RootSize.Y / BrickWorldSize)),
+        FMath::Max(1, FMath::CeilToInt32(RootSize.Z / BrickWorldSize)));
+
+    // 采样点从 Min 开始，最后一个采样点即为 Max
+    FIntVector SampleDims = GetSampleDims();
+    Bounds = FAxisAlignedBox3d(ExpandedMin,
+        ExpandedMin + FVector3d(SampleDims.X - 1, SampleDims.Y - 1, SampleDims.Z - 1) * VoxelSize);
+
+    BrickTable.SetNum(BrickDims.X * BrickDims.Y * BrickDims.Z);
+}
+
+int32 FMaVoxelData::AllocateBrick(const FIntVector& BrickCoord, const float* Values)
+{
+    FVoxelBrickCell& Cell = BrickTable[GetBrickLinearIndex(BrickCoord)];
+    if (Cell.IsAllocated())
+    {
+        if (Values)
+        {
+            WriteBrick(Cell.PoolIndex, Values);
+        }
+        return Cell.PoolIndex;
+    }
+
+    if (FreeBrickSlots.Num() > 0)
+    {
+        // 优先复用已释放的槽位
+        Cell.PoolIndex = FreeBrickSlots.Pop(EAllowShrinking::No);
+        BrickCoords[Cell.PoolIndex] = BrickCoord;
+    }
+    else
+    {
+        Cell.PoolIndex = BrickCoords.Add(BrickCoord);
+        BrickPool.AddUninitialized(GetBrickStride());
+        if (IsQuantized())
+        {
+            BrickScales.Add(0.0f);
+        }
+    }
+
+    if (Values)
+    {
+        WriteBrick(Cell.PoolIndex, Values);
+    }
+    else
+    {
+        // 新砖块以均匀值填充
+        float Uniform[BrickVoxelCount];
+        for (int32 i = 0; i < BrickVoxelCount; i++)
+        {
+            Uniform[i] = Cell.UniformValue;
+        }
+        WriteBrick(Cell.PoolIndex, Uniform);
+    }
+    return Cell.PoolIndex;
+}
+
+int32 FMaVoxelData::CollapseUniformBricks(const FAxisAlignedBox3d& Region, double BandVoxels)
+{
+    if (!IsValid() || Region.IsEmpty()) return 0;
+
+    // 与区域相交的砖块范围
+    FIntVector BrickMin, BrickMax;
+    GetBrickRange(Region, BrickMin, BrickMax);
+
+    TArray<FIntVector> Candidates;
+    for (int32 BZ = BrickMin.Z; BZ <= BrickMax.Z; BZ++)
+    {
+        for (int32 BY = BrickMin.Y; BY <= BrickMax.Y; BY++)
+        {
+            for (int32 BX = BrickMin.X; BX <= BrickMax.X; BX++)
+            {
+                FIntVector BrickCoord(BX, BY, BZ);
+                if (GetBrickCell(BrickCoord).IsAllocated())
+                {
+                    Candidates.Add(BrickCoord);
+                }
+            }
+        }
+    }
+    if (Candidates.Num() == 0) return 0;
+
+    // 量化格式下距离被截断在量化窄带内，阈值不能超过它
+    float Band = (float)(BandVoxels * VoxelSize);
+    if (IsQuantized())
+    {
+        Band = FMath::Min(Band, 0.99f * (float)(QuantizeBandVoxels * VoxelSize));
+    }
+
+    // 并行检查，串行释放
+    TArray<float> UniformValues;
+    UniformValues.SetNumUninitialized(Candidates.Num());
+    TArray<uint8> bCollapse;
+    bCollapse.SetNumZeroed(Candidates.Num());
+    ParallelFor(Candidates.Num(), [&](int32 Index)
+    {
+        float Scratch[BrickVoxelCount];
+        const float* Values = ReadBrick(GetBrickCell(Candidates[Index]).PoolIndex, Scratch);
+        float MinValue, MaxValue;
+        VoxelKernels::BrickMinMax(Values, BrickVoxelCount, MinValue, MaxValue);
+        if (MinValue >= Band)
+        {
+            UniformValues[Index] = MinValue;
+            bCollapse[Index] = 1;
+        }
+        else if (MaxValue <= -Band)
+        {
+            UniformValues[Index] = MaxValue;
+            bCollapse[Index] = 1;
+        }
+    });
+
+    int32 NumCollapsed = 0;
+    for (int32 Index = 0; Index < Candidates.Num(); Index++)
+    {
+        if (bCollapse[Index])
+        {
+            FreeBrick(Candidates[Index], UniformValues[Index]);
+            NumCollapsed++;
+        }
+    }
+    return NumCollapsed;
+}
+
+FAxisAlignedBox3d FMaVoxelData::ClearBricksOutside(const FIntVector& KeepMin, const FIntVector& KeepMax, float OutsideValue)
+{
+    FAxisAlignedBox3d ChangedBounds = FAxisAlignedBox3d::Empty();
+    if (!IsValid()) return ChangedBounds;
+
+    // 只改写索引表：每个条目的工作量是常数，不读取也不展开任何砖块
+    for (int32 BZ = 0; BZ < BrickDims.Z; BZ++)
+    {
+        for (int32 BY = 0; BY < BrickDims.Y; BY++)
+        {
+            for (int32 BX = 0; BX < BrickDims.X; BX++)
+            {
+                if (BX >= KeepMin.X && BX <= KeepMax.X && BY >= KeepMin.Y && BY <= KeepMax.Y && BZ >= KeepMin.Z && BZ <= KeepMax.Z)
+                {
+                    continue;
+                }
+
+                FIntVector BrickCoord(BX, BY, BZ);
+                FVoxelBrickCell& Cell = BrickTable[GetBrickLinearIndex(BrickCoord)];
+                if (Cell.IsAllocated() || Cell.IsFromParent())
+                {
+                    // 含有表面的砖块整体变为空（继承父级的砖块同样不再引用父级）
+                    FreeBrick(BrickCoord, OutsideValue);
+                    Cell.PoolIndex = INDEX_NONE;
+                    ChangedBounds.Contain(GetBrickBounds(BrickCoord));
+                }
+                else if (Cell.UniformValue < OutsideValue)
+                {
+                    // 实心砖块变为空时表面改变；已经是空的砖块只抬高距离下界
+                    if (Cell.UniformValue <= 0.0f)
+                    {
+                        ChangedBounds.Contain(GetBrickBounds(BrickCoord));
+                    }
+                    Cell.UniformValue = OutsideValue;
+                }
+            }
+        }
+    }
+    return ChangedBounds;
+}
+
+int32 FMaVoxelData::CompactPool(float MinFreeFraction)
+{
+    const int32 NumSlots = GetNumPoolSlots();
+    if (FreeBrickSlots.Num() == 0 || FreeBrickSlots.Num() < MinFreeFraction * NumSlots)
+    {
+        return 0;
+    }
+
+    // 从小到大填补空闲槽位，每次取末尾仍在使用的砖块
+    FreeBrickSlots.Sort();
+    const int64 BrickStride = GetBrickStride();
+    int32 NumMoved = 0;
+    int32 Last = NumSlots - 1;
+    for (int32 FreeSlot : FreeBrickSlots)
+    {
+        while (Last > FreeSlot && !IsPoolSlotInUse(Last))
+        {
+            Last--;
+        }
+        if (Last <= FreeSlot)
+        {
+            break;
+        }
+
+        const FIntVector BrickCoord = BrickCoords[Last];
+        FMemory::Memcpy(BrickPool.GetData() + FreeSlot * BrickStride, BrickPool.GetData() + Last * BrickStride, BrickStride);
+        if (IsQuantized())
+        {
+            BrickScales[FreeSlot] = BrickScales[Last];
+        }
+        BrickCoords[FreeSlot] = BrickCoord;
+        BrickCoords[Last] = FreeSlotCoord;
+        BrickTable[GetBrickLinearIndex(BrickCoord)].PoolIndex = FreeSlot;
+        NumMoved++;
+        Last--;
+    }
+
+    // 使用中的砖块已全部位于前部
+    const int32 NumUsed = NumSlots - FreeBrickSlots.Num();
+    FreeBrickSlots.Empty();
+    BrickCoords.SetNum(NumUsed);
+    BrickCoords.Shrink();
+    BrickPool.SetNum(NumUsed * BrickStride);
+    BrickPool.Shrink();
+    if (IsQuantized())
+    {
+        BrickScales.SetNum(NumUsed);
+        BrickScales.Shrink();
+    }
+    return NumMoved;
+}
+
+const float* FMaVoxelData::ReadBrick(int32 PoolIndex, float* Scratch) const
+{
+    const uint8* Data = BrickPool.GetData() + PoolIndex * GetBrickStride();
+    switch (StorageFormat)
+    {
+    case EVoxelStorageFormat::Int16:
+        DequantizeBrick(reinterpret_cast<const int16*>(Data), BrickScales[PoolIndex], Scratch);
+        return Scratch;
+    case EVoxelStorageFormat::Int8:
+        DequantizeBrick(reinterpret_cast<const int8*>(Data), BrickScales[PoolIndex], Scratch);
+        return Scratch;
+    default:
+        return reinterpret_cast<const float*>(Data);
+    }
+}
+
+void FMaVoxelData::WriteBrick(int32 PoolIndex, const float* Values)
+{
+    uint8* Data = BrickPool.GetData() + PoolIndex * GetBrickStride();
+    const float Band = (float)(QuantizeBandVoxels * VoxelSize);
+    switch (StorageFormat)
+    {
+    case EVoxelStorageFormat::Int16:
+        BrickScales[PoolIndex] = QuantizeBrick(Values, Band, reinterpret_cast<int16*>(Data));
+        break;
+    case EVoxelStorageFormat::Int8:
+        BrickScales[PoolIndex] = QuantizeBrick(Values, Band, reinterpret_cast<int8*>(Data));
+        break;
+    default:
+        FMemory::Memcpy(Data, Values, BrickVoxelCount * sizeof(float));
+        break;
+    }
+}
+
+float FMaVoxelData::GetBrickValue(int32 PoolIndex, int32 LocalIndex) const
+{
+    const uint8* Data = BrickPool.GetData() + PoolIndex * GetBrickStride();
+    switch (StorageFormat)
+    {
+    case EVoxelStorageFormat::Int16:
+        return (float)reinterpret_cast<const int16*>(Data)[LocalIndex] * BrickScales[PoolIndex];
+    case EVoxelStorageFormat::Int8:
+        return (float)reinterpret_cast<const int8*>(Data)[LocalIndex] * BrickScales[PoolIndex];
+    default:
+        return reinterpret_cast<const float*>(Data)[LocalIndex];
+    }
+}
+
+const float* FMaVoxelData::ReadCell(const FIntVector& BrickCoord, float* Scratch) const
+{
+    const FVoxelBrickCell& Cell = GetBrickCell(BrickCoord);
+    if (Cell.IsAllocated())
+    {
+        return ReadBrick(Cell.PoolIndex, Scratch);
+    }
+    if (Cell.IsFromParent())
+    {
+        ResampleFromParent(BrickCoord, Scratch);
+        return Scratch;
+    }
+    return nullptr;
+}
+
+FAxisAlignedBox3d FMaVoxelData::GetBrickBounds(const FIntVector& BrickCoord) const
+{
+    FVector3d BrickMin = GetSamplePosition(BrickCoord.X * BrickSize, BrickCoord.Y * BrickSize, BrickCoord.Z * BrickSize);
+    return FAxisAlignedBox3d(BrickMin, BrickMin + FVector3d((BrickSize - 1) * VoxelSize));
+}
+
+void FMaVoxelData::GetBrickRange(const FAxisAlignedBox3d& Region, FIntVector& OutMin, FIntVector& OutMax) const
+{
+    FVector3d MinCoord = (Region.Min - Bounds.Min) / (VoxelSize * BrickSize);
+    FVector3d MaxCoord = (Region.Max - Bounds.Min) / (VoxelSize * BrickSize);
+    OutMin = FIntVector(
+        FMath::Max(0, FMath::FloorToInt32(MinCoord.X)),
+        FMath::Max(0, FMath::FloorToInt32(MinCoord.Y)),
+        FMath::Max(0, FMath::FloorToInt32(MinCoord.Z)));
+    OutMax = FIntVector(
+        FMath::Min(BrickDims.X - 1, FMath::FloorToInt32(MaxCoord.X)),
+        FMath::Min(BrickDims.Y - 1, FMath::FloorToInt32(MaxCoord.Y)),
+        FMath::Min(BrickDims.Z - 1, FMath::FloorToInt32(MaxCoord.Z)));
+}
+
+float FMaVoxelData::GetSample(int32 X, int32 Y, int32 Z) const
+{
+    const FVoxelBrickCell& Cell = BrickTable[GetBrickLinearIndex(FIntVector(X / BrickSize, Y / BrickSize, Z / BrickSize))];
+    if (!Cell.IsAllocated())
+    {
+        return Cell.IsFromParent() ? Parent->GetValueAtPosition(ClampToParentBounds(GetSamplePosition(X, Y, Z))) : Cell.UniformValue;
+    }
+    return GetBrickValue(Cell.PoolIndex, GetLocalVoxelIndex(X % BrickSize, Y % BrickSize, Z % BrickSize));
+}
+
+bool FMaVoxelData::BuildOctreeFromMesh(const FDynamicMesh3& Mesh, const FTransform& Transform, FProgressCancel* Progress)
+{
+	if (Mesh.TriangleCount() == 0)
     {
         UE_LOG(LogTemp, Warning, TEXT("BuildOctreeFromMesh: Mesh has no triangles"));
+        return false;
+    }
+
+    double StartTime = FPlatformTime::Seconds();
+
+    // 计算网格边界并建立砖块网格
+    FAxisAlignedBox3d LocalBounds = Mesh.GetBounds();
+    FAxisAlignedBox3d WorldBounds(LocalBounds, Transform);
+    InitializeBrickGrid(WorldBounds);
+
+    // 创建空间查询结构
+    FDynamicMesh3 WorldSpaceMesh = Mesh;
+    MeshTransforms::ApplyTransform(WorldSpaceMesh, Transform, true);
+    FDynamicMeshAABBTree3 Spatial(&WorldSpaceMesh);
+    TFastWindingTree<FDynamicMesh3> Winding(&Spatial);
+
+    // 从覆盖整个砖块网格的根节点开始按到表面的距离细分：
+    // 远离表面的节点整体存为常量（实心或空），只有窄带内的砖块逐体素采样
+    const double BandWidth = VoxelSize * BrickSize;
+    int32 RootBricks = 1;
+    while (RootBricks < BrickDims.GetMax())
+    {
+        RootBricks *= 2;
+    }
+
+    // 1. 自顶向下分类：子树并行，收集需要逐体素采样的窄带砖块
+    FProgressCancel::FProgressScope ClassifyScope(Progress, 0.1f);
+    TArray<FIntVector> BandBricks;
+    ClassifyBrickNode(Spatial, Winding, FIntVector::ZeroValue, RootBricks, BandWidth, BandBricks, Progress);
+    if (Progress && Progress->Cancelled())
+    {
+        Reset();
+        return false;
+    }
+    ClassifyScope.Done();
+
+    // 2. 窄带砖块逐体素采样。每个砖块的工作量相同，按小批次分配给各线程，先写入暂存区；
+    // 分几轮进行，每轮之间报告进度并检查取消
+    FProgressCancel::FProgressScope SampleScope(Progress, 0.85f);
+    TArray<float> Staging;
+    Staging.SetNumUninitialized(BandBricks.Num() * BrickVoxelCount);
+    TArray<uint8> InBand;
+    InBand.SetNumZeroed(BandBricks.Num());
+    const int32 NumRounds = FMath::Clamp(BandBricks.Num() / 256, 1, 16);
+    for (int32 Round = 0; Round < NumRounds; Round++)
+    {
+        int32 Begin = (int32)((int64)BandBricks.Num() * Round / NumRounds);
+        int32 End = (int32)((int64)BandBricks.Num() * (Round + 1) / NumRounds);
+        ParallelFor(TEXT("VoxelBuildBricks"), End - Begin, BuildBricksPerBatch, [&](int32 i)
+        {
+            int32 Index = Begin + i;
+            InBand[Index] = SampleBrick(Spatial, Winding, BandBricks[Index], BandWidth, Staging.GetData() + (int64)Index * BrickVoxelCount) ? 1 : 0;
+        });
+
+        if (Progress && Progress->Cancelled())
+        {
+            Reset();
+            return false;
+        }
+        SampleScope.AdvanceProgressTo((float)(Round + 1) / NumRounds);
+    }
+    SampleScope.Done();
+
+    // 3. 串行写入砖块池（先按窄带砖块数一次预留容量）
+    int32 NumInBand = 0;
+    for (uint8 bInBand : InBand)
+    {
+        NumInBand += bInBand;
+    }
+    ReserveBricks(NumInBand);
+    for (int32 Index = 0; Index < BandBricks.Num(); Index++)
+    {
+        const float* BrickValues = Staging.GetData() + (int64)Index * BrickVoxelCount;
+        if (InBand[Index])
+        {
+            AllocateBrick(BandBricks[Index], BrickValues);
+        }
+        else
+        {
+            // 窄带外的砖块保存最靠近表面的值（整个砖块同号）
+            float MinValue, MaxValue;
+            VoxelKernels::BrickMinMax(BrickValues, BrickVoxelCount, MinValue, MaxValue);
+            float NearestValue = (BrickValues[0] < 0.0f) ? MaxValue : MinValue;
+            BrickTable[GetBrickLinearIndex(BandBricks[Index])].UniformValue = NearestValue;
+        }
+    }
+
+    double EndTime = FPlatformTime::Seconds();
+    UE_LOG(LogTemp, Warning, TEXT("八叉树构建耗时: %.2f 毫秒"), (EndTime - StartTime) * 1000.0);
+
+    DebugLogOctreeStats();
+    return true;
+}
+
+void FMaVoxelData::ClassifyBrickNode(const FDynamicMeshAABBTree3& Spatial, TFastWindingTree<FDynamicMesh3>& Winding,
+    const FIntVector& NodeMin, int32 NodeBricks, double BandWidth, TArray<FIntVector>& OutBandBricks, FProgressCancel* Progress)
+{
+    // 取消后剩余节点都不再处理，调用方负责清空数据
+    if (Progress && Progress->Cancelled())
+    {
+        return;
+    }
+
+    // 节点裁剪到砖块网格内 [NodeMin, NodeMax)
+    FIntVector NodeMax(
+        FMath::Min(NodeMin.X + NodeBricks, BrickDims.X),
+        FMath::Min(NodeMin.Y + NodeBricks, BrickDims.Y),
+        FMath::Min(NodeMin.Z + NodeBricks, BrickDims.Z));
+    if (NodeMin.X >= NodeMax.X || NodeMin.Y >= NodeMax.Y || NodeMin.Z >= NodeMax.Z)
+    {
+        return;
+    }
+
+    // 节点中心到表面的距离减去节点半对角线，仍大于窄带宽度时整个节点都远离表面
+    FVector3d NodeLo = GetSamplePosition(NodeMin.X * BrickSize, NodeMin.Y * BrickSize, NodeMin.Z * BrickSize);
+    FVector3d NodeHi = GetSamplePosition(NodeMax.X * BrickSize - 1, NodeMax.Y * BrickSize - 1, NodeMax.Z * BrickSize - 1);
+    FVector3d Center = 0.5 * (NodeLo + NodeHi);
+    double Radius = 0.5 * FVector3d::Distance(NodeLo, NodeHi);
+
+    double NearestDistSqr;
+    Spatial.FindNearestTriangle(Center, NearestDistSqr);
+    double CenterDistance = FMath::Sqrt(NearestDistSqr);
+
+    if (CenterDistance > Radius + BandWidth)
+    {
+        // 一次内外判定决定整个节点的符号；每个砖块保存距离下界，保证插值时场仍然连续
+        float Sign = Winding.IsInside(Center) ? -1.0f : 1.0f;
+        for (int32 BZ = NodeMin.Z; BZ < NodeMax.Z; BZ++)
+        {
+            for (int32 BY = NodeMin.Y; BY < NodeMax.Y; BY++)
+            {
+                for (int32 BX = NodeMin.X; BX < NodeMax.X; BX++)
+                {
+                    FIntVector BrickCoord(BX, BY, BZ);
+                    FAxisAlignedBox3d BrickBounds = GetBrickBounds(BrickCoord);
+                    double LowerBound = CenterDistance - FVector3d::Distance(BrickBounds.Center(), Center) - 0.5 * BrickBounds.DiagonalLength();
+                    BrickTable[GetBrickLinearIndex(BrickCoord)].UniformValue = Sign * (float)FMath::Max(LowerBound, BandWidth);
+                }
+            }
+        }
+        return;
+    }
+
+    if (NodeBricks == 1)
+    {
+        OutBandBricks.Add(NodeMin);
         return;
     }
-    
+
+    // 靠近表面：细分为 8 个子节点。大的子树作为独立任务并行处理，各自收集结果后按顺序合并；
+    // 小子树直接递归，避免任务过细
+    int32 ChildBricks = NodeBricks / 2;
+    if (ChildBricks >= ParallelNodeBricks)
+    {
+        TArray<FIntVector> ChildBandBricks[8];
+        ParallelFor(8, [&](int32 i)
+        {
+            FIntVector ChildMin = NodeMin + FIntVector(i & 1, (i >> 1) & 1, (i >> 2) & 1) * ChildBricks;
+            ClassifyBrickNode(Spatial, Winding, ChildMin, ChildBricks, BandWidth, ChildBandBricks[i], Progress);
+        });
+        for (const TArray<FIntVector>& Child : ChildBandBricks)
+        {
+            OutBandBricks.Append(Child);
+        }
+    }
+    else
+    {
+        for (int32 i = 0; i < 8; i++)
+        {
+            FIntVector ChildMin = NodeMin + FIntVector(i & 1, (i >> 1) & 1, (i >> 2) & 1) * ChildBricks;
+            ClassifyBrickNode(Spatial, Winding, ChildMin, ChildBricks, BandWidth, OutBandBricks, Progress);
+        }
+    }
+}
+
+bool FMaVoxelData::SampleBrick(const FDynamicMeshAABBTree3& Spatial, TFastWindingTree<FDynamicMesh3>& Winding,
+    const FIntVector& BrickCoord, double BandWidth, float* OutValues) const
+{
+    FVector3d BrickMin = GetSamplePosition(BrickCoord.X * BrickSize, BrickCoord.Y * BrickSize, BrickCoord.Z * BrickSize);
+
+    // 检查砖块是否落在窄带内
+    bool bInBand = false;
+    for (int32 Z = 0; Z < BrickSize; Z++)
+    {
+        for (int32 Y = 0; Y < BrickSize; Y++)
+        {
+            for (int32 X = 0; X < BrickSize; X++)
+            {
+                FVector3d WorldPos = BrickMin + FVector3d(X, Y, Z) * VoxelSize;
+                float Distance = CalculateDistanceToMesh(Spatial, Winding, WorldPos);
+                OutValues[GetLocalVoxelIndex(X, Y, Z)] = Distance;
+                bInBand |= FMath::Abs(Distance) < BandWidth;
+            }
+        }
+    }
+    return bInBand;
+}
+
+bool FMaVoxelData::BuildFromMeshRasterized(const FDynamicMesh3& Mesh, const FTransform& Transform, FProgressCancel* Progress)
+{
+    if (Mesh.TriangleCount() == 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("BuildFromMeshRasterized: Mesh has no triangles"));
+        return false;
+    }
+
+    // 取消时清空数据
+    auto CheckCancelled = [this, Progress]()
+    {
+        if (Progress && Progress->Cancelled())
+        {
+            Reset();
+            return true;
+        }
+        return false;
+    };
+
     double StartTime = FPlatformTime::Seconds();
-    
-    // 计算网格边界
+
+    // 计算网格边界并建立砖块网格
     FAxisAlignedBox3d LocalBounds = Mesh.GetBounds();
     FAxisAlignedBox3d WorldBounds(LocalBounds, Transform);
-    
-    // 设置八叉树根节点边界（稍微扩展）
-    FVector3d ExpandedMin = WorldBounds.Min - FVector3d(2.0 * MarchingCubeSize);
-    FVector3d ExpandedMax = WorldBounds.Max + FVector3d(2.0 * MarchingCubeSize);
-    OctreeRoot.Bounds = FAxisAlignedBox3d(ExpandedMin, ExpandedMax);
-    OctreeRoot.Depth = 0;
-    OctreeRoot.bIsLeaf = true;
-    OctreeRoot.bIsEmpty = true;
-    
-    // 创建空间查询结构
-    FDynamicMesh3 WorldSpaceMesh = Mesh;
-    MeshTransforms::ApplyTransform(WorldSpaceMesh, Transform, true);
-    FDynamicMeshAABBTree3 Spatial(&WorldSpaceMesh);    
-    TFastWindingTree<FDynamicMesh3> Winding(&Spatial);
-    
-    // 递归构建八叉树
-    TFunction<void(FOctreeNode&)> BuildNode = [&](FOctreeNode& Node)
-    {
-        FVector3d NodeSize = Node.Bounds.Max - Node.Bounds.Min;
-        double MinNodeSize = NodeSize.GetMin();
-        
-        // 如果节点足够小或者达到最大深度，设为叶子节点
-        if (MinNodeSize <= MinVoxelSize || Node.Depth >= MaxOctreeDepth)
-        {
-            Node.bIsLeaf = true;
-            
-            // 为叶子节点分配体素存储（2x2x2 最小分辨率）
-            int32 VoxelsPerSide = 2;
-            if (MinNodeSize > MinVoxelSize * 2) 
+    InitializeBrickGrid(WorldBounds);
+
+    TArray<FTriangle3d> Triangles;
+    Triangles.Reserve(Mesh.TriangleCount());
+    for (int32 TriangleID : Mesh.TriangleIndicesItr())
+    {
+        FVector3d A, B, C;
+        Mesh.GetTriVertices(TriangleID, A, B, C);
+        Triangles.Add(FTriangle3d(Transform.TransformPosition(A), Transform.TransformPosition(B), Transform.TransformPosition(C)));
+    }
+
+    const FIntVector SampleDims = GetSampleDims();
+    const double BandWidth = VoxelSize * BrickSize;             // 窄带宽度，与逐点查询时的分配条件一致
+    const double ExactBand = 2.0 * VoxelSize;                   // 直接计算精确距离的范围
+    const double BrickRadius = 0.5 * (BrickSize - 1) * VoxelSize * FMath::Sqrt(3.0);
+
+    // 世界范围 -> 覆盖的采样点范围
+    auto GetSampleRange = [&](const FAxisAlignedBox3d& Box, FIntVector& OutMin, FIntVector& OutMax)
+    {
+        FVector3d MinCoord = (Box.Min - Bounds.Min) / VoxelSize;
+        FVector3d MaxCoord = (Box.Max - Bounds.Min) / VoxelSize;
+        OutMin = FIntVector(
+            FMath::Max(0, FMath::CeilToInt32(MinCoord.X)),
+            FMath::Max(0, FMath::CeilToInt32(MinCoord.Y)),
+            FMath::Max(0, FMath::CeilToInt32(MinCoord.Z)));
+        OutMax = FIntVector(
+            FMath::Min(SampleDims.X - 1, FMath::FloorToInt32(MaxCoord.X)),
+            FMath::Min(SampleDims.Y - 1, FMath::FloorToInt32(MaxCoord.Y)),
+            FMath::Min(SampleDims.Z - 1, FMath::FloorToInt32(MaxCoord.Z)));
+        return OutMin.X <= OutMax.X && OutMin.Y <= OutMax.Y && OutMin.Z <= OutMax.Z;
+    };
+    auto GetTriangleBounds = [](const FTriangle3d& Triangle, double Expand)
+    {
+        FAxisAlignedBox3d Box(Triangle.V[0], Triangle.V[1]);
+        Box.Contain(Triangle.V[2]);
+        Box.Expand(Expand);
+        return Box;
+    };
+
+    // 1. 找出窄带内的候选砖块，并为每个砖块收集需要精确计算距离的三角形
+    TArray<int32> CandidateIndex;
+    CandidateIndex.Init(INDEX_NONE, BrickTable.Num());
+    TArray<FIntVector> Candidates;
+    TArray<TArray<int32>> CandidateTriangles;
+    for (int32 TriIndex = 0; TriIndex < Triangles.Num(); TriIndex++)
+    {
+        const FTriangle3d& Triangle = Triangles[TriIndex];
+        FIntVector SampleMin, SampleMax;
+        if (!GetSampleRange(GetTriangleBounds(Triangle, BandWidth), SampleMin, SampleMax))
+        {
+            continue;
+        }
+
+        FIntVector BrickMin = SampleMin / BrickSize;
+        FIntVector BrickMax = SampleMax / BrickSize;
+        for (int32 BZ = BrickMin.Z; BZ <= BrickMax.Z; BZ++)
+        {
+            for (int32 BY = BrickMin.Y; BY <= BrickMax.Y; BY++)
+            {
+                for (int32 BX = BrickMin.X; BX <= BrickMax.X; BX++)
+                {
+                    FIntVector BrickCoord(BX, BY, BZ);
+                    double CenterDistance = FMath::Sqrt(FDistPoint3Triangle3d(GetBrickBounds(BrickCoord).Center(), Triangle).GetSquared());
+                    if (CenterDistance > BandWidth + BrickRadius)
+                    {
+                        continue;
+                    }
+
+                    int32& Index = CandidateIndex[GetBrickLinearIndex(BrickCoord)];
+                    if (Index == INDEX_NONE)
+                    {
+                        Index = Candidates.Add(BrickCoord);
+                        CandidateTriangles.AddDefaulted();
+                    }
+                    if (CenterDistance <= ExactBand + BrickRadius)
+                    {
+                        CandidateTriangles[Index].Add(TriIndex);
+                    }
+                }
+            }
+        }
+    }
+
+    const int32 NumCandidates = Candidates.Num();
+    TArray<float> Distances;
+    Distances.Init(TNumericLimits<float>::Max(), NumCandidates * BrickVoxelCount);
+    TArray<int32> ClosestTriangles;
+    ClosestTriangles.Init(INDEX_NONE, NumCandidates * BrickVoxelCount);
+
+    if (CheckCancelled()) return false;
+
+    // 2. 光栅化：三角形附近的采样点直接计算精确距离（每个砖块独立，可并行）
+    FProgressCancel::FProgressScope SeedScope(Progress, 0.3f);
+    ParallelFor(NumCandidates, [&](int32 Index)
+    {
+        FIntVector Origin = Candidates[Index] * BrickSize;
+        float* BrickDistances = Distances.GetData() + (int64)Index * BrickVoxelCount;
+        int32* BrickClosest = ClosestTriangles.GetData() + (int64)Index * BrickVoxelCount;
+
+        for (int32 TriIndex : CandidateTriangles[Index])
+        {
+            const FTriangle3d& Triangle = Triangles[TriIndex];
+            FIntVector SampleMin, SampleMax;
+            if (!GetSampleRange(GetTriangleBounds(Triangle, ExactBand), SampleMin, SampleMax))
             {
-                VoxelsPerSide = 4; // 中等大小节点
+                continue;
             }
-            if (MinNodeSize > MinVoxelSize * 4) 
+
+            int32 X0 = FMath::Max(SampleMin.X - Origin.X, 0), X1 = FMath::Min(SampleMax.X - Origin.X, BrickSize - 1);
+            int32 Y0 = FMath::Max(SampleMin.Y - Origin.Y, 0), Y1 = FMath::Min(SampleMax.Y - Origin.Y, BrickSize - 1);
+            int32 Z0 = FMath::Max(SampleMin.Z - Origin.Z, 0), Z1 = FMath::Min(SampleMax.Z - Origin.Z, BrickSize - 1);
+            for (int32 Z = Z0; Z <= Z1; Z++)
             {
-                VoxelsPerSide = 8; // 较大节点
+                for (int32 Y = Y0; Y <= Y1; Y++)
+                {
+                    for (int32 X = X0; X <= X1; X++)
+                    {
+                        int32 Local = GetLocalVoxelIndex(X, Y, Z);
+                        FVector3d Pos = GetSamplePosition(Origin.X + X, Origin.Y + Y, Origin.Z + Z);
+                        float Distance = (float)FMath::Sqrt(FDistPoint3Triangle3d(Pos, Triangle).GetSquared());
+                        if (Distance < BrickDistances[Local])
+                        {
+                            BrickDistances[Local] = Distance;
+                            BrickClosest[Local] = TriIndex;
+                        }
+                    }
+                }
             }
-            Node.Voxels.SetNumZeroed(VoxelsPerSide * VoxelsPerSide * VoxelsPerSide);
-            Node.VoxelsPerSide = VoxelsPerSide;
-            
-            // 计算叶子节点内每个体素的值
-            FVector3d VoxelSizeLeaf = Node.Bounds.Extents() / (VoxelsPerSide - 1);
-            Node.bIsEmpty = true;
-            
-        	std::atomic<bool> bNodeNonEmpty(false);  // 原子变量，用于线程安全地更新节点状态
-
-        	// 并行处理Z轴
-        	ParallelFor(VoxelsPerSide, [&](int32 Z)
-			{
-				for (int32 Y = 0; Y < VoxelsPerSide; Y++)
-				{
-					for (int32 X = 0; X < VoxelsPerSide; X++)
-					{
-						FVector3d LocalPos = FVector3d(X, Y, Z) * VoxelSizeLeaf;
-						FVector3d WorldPos = Node.Bounds.Min + LocalPos;
-            
-						float Distance = CalculateDistanceToMesh(Spatial, Winding, WorldPos);
-						int32 Index = Z * VoxelsPerSide * VoxelsPerSide + Y * VoxelsPerSide + X;
-						Node.Voxels[Index] = Distance;
-            
-						// 检查节点是否变为非空
-						if (Distance < NodeSize.GetMax())
-						{
-							bNodeNonEmpty = true;  // 原子操作，线程安全
-						}
-					}
-				}
-			});
-
-        	Node.bIsEmpty = !bNodeNonEmpty;
         }
-        else
+    });
+
+    SeedScope.Done();
+    if (CheckCancelled()) return false;
+
+    // 3. 快速扫描：沿 8 个方向传播最近三角形，并用传来的三角形重新计算精确距离
+    auto FindSample = [&](int32 X, int32 Y, int32 Z) -> int32
+    {
+        if (X < 0 || Y < 0 || Z < 0 || X >= SampleDims.X || Y >= SampleDims.Y || Z >= SampleDims.Z)
+        {
+            return INDEX_NONE;
+        }
+        int32 Index = CandidateIndex[GetBrickLinearIndex(FIntVector(X / BrickSize, Y / BrickSize, Z / BrickSize))];
+        return Index == INDEX_NONE ? INDEX_NONE : Index * BrickVoxelCount + GetLocalVoxelIndex(X % BrickSize, Y % BrickSize, Z % BrickSize);
+    };
+
+    FProgressCancel::FProgressScope SweepScope(Progress, 0.5f);
+    TArray<int32> SweepOrder;
+    SweepOrder.SetNumUninitialized(NumCandidates);
+    for (int32 Sweep = 0; Sweep < 8; Sweep++)
+    {
+        if (CheckCancelled()) return false;
+        SweepScope.AdvanceProgressTo(Sweep / 8.0f);
+
+        const FIntVector Dir((Sweep & 1) ? -1 : 1, (Sweep & 2) ? -1 : 1, (Sweep & 4) ? -1 : 1);
+
+        // 砖块按扫描方向排序，保证每个采样点的上游邻居先于它处理
+        for (int32 i = 0; i < NumCandidates; i++)
         {
-            // 需要继续细分
-            Node.Subdivide(MinVoxelSize);
-            for (FOctreeNode& Child : Node.Children)
+            SweepOrder[i] = i;
+        }
+        SweepOrder.Sort([&Candidates, &Dir](int32 A, int32 B)
+        {
+            const FIntVector& CA = Candidates[A];
+            const FIntVector& CB = Candidates[B];
+            if (CA.Z != CB.Z) return CA.Z * Dir.Z < CB.Z * Dir.Z;
+            if (CA.Y != CB.Y) return CA.Y * Dir.Y < CB.Y * Dir.Y;
+            return CA.X * Dir.X < CB.X * Dir.X;
+        });
+
+        for (int32 Index : SweepOrder)
+        {
+            FIntVector Origin = Candidates[Index] * BrickSize;
+            for (int32 k = 0; k < BrickSize; k++)
+            {
+                int32 Z = Origin.Z + (Dir.Z > 0 ? k : BrickSize - 1 - k);
+                for (int32 j = 0; j < BrickSize; j++)
+                {
+                    int32 Y = Origin.Y + (Dir.Y > 0 ? j : BrickSize - 1 - j);
+                    for (int32 i = 0; i < BrickSize; i++)
+                    {
+                        int32 X = Origin.X + (Dir.X > 0 ? i : BrickSize - 1 - i);
+                        int32 Sample = Index * BrickVoxelCount + GetLocalVoxelIndex(X - Origin.X, Y - Origin.Y, Z - Origin.Z);
+                        FVector3d Pos = GetSamplePosition(X, Y, Z);
+
+                        const int32 Upstream[3] = {
+                            FindSample(X - Dir.X, Y, Z),
+                            FindSample(X, Y - Dir.Y, Z),
+                            FindSample(X, Y, Z - Dir.Z) };
+                        for (int32 Neighbor : Upstream)
+                        {
+                            if (Neighbor == INDEX_NONE) continue;
+                            int32 TriIndex = ClosestTriangles[Neighbor];
+                            if (TriIndex == INDEX_NONE || TriIndex == ClosestTriangles[Sample]) continue;
+
+                            float Distance = (float)FMath::Sqrt(FDistPoint3Triangle3d(Pos, Triangles[TriIndex]).GetSquared());
+                            if (Distance < Distances[Sample])
+                            {
+                                Distances[Sample] = Distance;
+                                ClosestTriangles[Sample] = TriIndex;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    SweepScope.Done();
+    if (CheckCancelled()) return false;
+
+    // 4. 内外判定：沿 X 方向的扫描线与三角形求交，交点按行保存，采样点左侧交点数为奇数即在内部
+    TArray<TArray<double>> RowCrossings;
+    RowCrossings.SetNum(SampleDims.Y * SampleDims.Z);
+    for (const FTriangle3d& Triangle : Triangles)
+    {
+        FVector2d P0(Triangle.V[0].Y, Triangle.V[0].Z);
+        FVector2d P1(Triangle.V[1].Y, Triangle.V[1].Z);
+        FVector2d P2(Triangle.V[2].Y, Triangle.V[2].Z);
+        double X0 = Triangle.V[0].X, X1 = Triangle.V[1].X, X2 = Triangle.V[2].X;
+
+        // 统一为逆时针，投影退化的三角形不与扫描线相交
+        double Area = EdgeFunction(P0, P1, P2);
+        if (Area == 0.0) continue;
+        if (Area < 0.0)
+        {
+            Swap(P1, P2);
+            Swap(X1, X2);
+        }
+
+        FIntVector SampleMin, SampleMax;
+        if (!GetSampleRange(GetTriangleBounds(Triangle, 0.0), SampleMin, SampleMax)) continue;
+
+        for (int32 Z = SampleMin.Z; Z <= SampleMax.Z; Z++)
+        {
+            for (int32 Y = SampleMin.Y; Y <= SampleMax.Y; Y++)
             {
-                BuildNode(Child);
+                FVector2d Q(Bounds.Min.Y + Y * VoxelSize, Bounds.Min.Z + Z * VoxelSize);
+                double W0 = EdgeFunction(P1, P2, Q);
+                double W1 = EdgeFunction(P2, P0, Q);
+                double W2 = EdgeFunction(P0, P1, Q);
+                if (W0 < 0.0 || W1 < 0.0 || W2 < 0.0) continue;
+                if ((W0 == 0.0 && !IsOwnedEdge(P1, P2)) || (W1 == 0.0 && !IsOwnedEdge(P2, P0)) || (W2 == 0.0 && !IsOwnedEdge(P0, P1))) continue;
+
+                double Sum = W0 + W1 + W2;
+                RowCrossings[Z * SampleDims.Y + Y].Add((W0 * X0 + W1 * X1 + W2 * X2) / Sum);
             }
-            
-            // 检查子节点是否都为空
-            Node.bIsEmpty = true;
-            for (const FOctreeNode& Child : Node.Children)
+        }
+    }
+    ParallelFor(RowCrossings.Num(), [&RowCrossings](int32 Row)
+    {
+        RowCrossings[Row].Sort();
+    });
+
+    auto IsInside = [&](int32 X, int32 Y, int32 Z)
+    {
+        const TArray<double>& Crossings = RowCrossings[Z * SampleDims.Y + Y];
+        int32 Count = Algo::LowerBound(Crossings, Bounds.Min.X + X * VoxelSize);
+        return (Count & 1) != 0;
+    };
+
+    // 5. 写入砖块：候选砖块加上符号，窄带内的分配；其余砖块只保存带符号的窄带宽度
+    TArray<uint8> InBand;
+    InBand.SetNumZeroed(NumCandidates);
+    ParallelFor(NumCandidates, [&](int32 Index)
+    {
+        FIntVector Origin = Candidates[Index] * BrickSize;
+        float* BrickDistances = Distances.GetData() + (int64)Index * BrickVoxelCount;
+        const int32* BrickClosest = ClosestTriangles.GetData() + (int64)Index * BrickVoxelCount;
+        for (int32 Z = 0; Z < BrickSize; Z++)
+        {
+            for (int32 Y = 0; Y < BrickSize; Y++)
             {
-                if (!Child.bIsEmpty)
+                for (int32 X = 0; X < BrickSize; X++)
                 {
-                    Node.bIsEmpty = false;
-                    break;
+                    int32 Local = GetLocalVoxelIndex(X, Y, Z);
+                    float Distance = (BrickClosest[Local] == INDEX_NONE) ? (float)BandWidth : BrickDistances[Local];
+                    InBand[Index] |= (Distance < BandWidth) ? 1 : 0;
+                    BrickDistances[Local] = IsInside(Origin.X + X, Origin.Y + Y, Origin.Z + Z) ? -Distance : Distance;
                 }
             }
         }
-    };
-    
-    BuildNode(OctreeRoot);
-    
+    });
+
+    int32 NumInBand = 0;
+    for (uint8 bInBand : InBand)
+    {
+        NumInBand += bInBand;
+    }
+    ReserveBricks(NumInBand);
+    for (int32 Index = 0; Index < NumCandidates; Index++)
+    {
+        const float* BrickDistances = Distances.GetData() + (int64)Index * BrickVoxelCount;
+        if (InBand[Index])
+        {
+            AllocateBrick(Candidates[Index], BrickDistances);
+        }
+        else
+        {
+            // 窄带外的砖块保存最靠近表面的值（整个砖块同号）
+            float MinValue, MaxValue;
+            VoxelKernels::BrickMinMax(BrickDistances, BrickVoxelCount, MinValue, MaxValue);
+            float NearestValue = (BrickDistances[0] < 0.0f) ? MaxValue : MinValue;
+            BrickTable[GetBrickLinearIndex(Candidates[Index])].UniformValue = NearestValue;
+        }
+    }
+
+    ParallelFor(BrickTable.Num(), [&](int32 Linear)
+    {
+        if (CandidateIndex[Linear] != INDEX_NONE) return;
+
+        FIntVector BrickCoord(Linear % BrickDims.X, (Linear / BrickDims.X) % BrickDims.Y, Linear / (BrickDims.X * BrickDims.Y));
+        FIntVector Center = BrickCoord * BrickSize + FIntVector(BrickSize / 2);
+        BrickTable[Linear].UniformValue = IsInside(Center.X, Center.Y, Center.Z) ? -(float)BandWidth : (float)BandWidth;
+    });
+
     double EndTime = FPlatformTime::Seconds();
-    UE_LOG(LogTemp, Warning, TEXT("八叉树构建耗时: %.2f 毫秒"), (EndTime - StartTime) * 1000.0);
+    UE_LOG(LogTemp, Warning, TEXT("光栅化体素化耗时: %.2f 毫秒, 候选砖块=%d"), (EndTime - StartTime) * 1000.0, NumCandidates);
 
     DebugLogOctreeStats();
+    return true;
 }
 
 float FMaVoxelData::GetValueAtPosition(const FVector3d& WorldPos) const
 {
-    // 八叉树查询
-    TFunction<float(const FOctreeNode&, const FVector3d&)> QueryNode = 
-    [&](const FOctreeNode& Node, const FVector3d& Point) -> float
-    {
-        if (!Node.ContainsPoint(Point)) return 1.0f;
-        
-        if (Node.bIsLeaf)
-        {
-            if (Node.bIsEmpty) return 1.0f;
-            
-            // 在叶子节点内插值
-            FVector3d LocalPos = Point - Node.Bounds.Min;
-            FVector3d Size = Node.Bounds.Max - Node.Bounds.Min;
-            
-            int32 VoxelsPerSide = Node.VoxelsPerSide;
-            if (VoxelsPerSide <= 1) return 1.0f;
-            
-            FVector3d VoxelSizeLeaf = Size / (VoxelsPerSide - 1);
-            
-            FVector3d Coord = LocalPos / VoxelSizeLeaf;
-            int32 X = FMath::Clamp(FMath::FloorToInt(Coord.X), 0, VoxelsPerSide - 2);
-            int32 Y = FMath::Clamp(FMath::FloorToInt(Coord.Y), 0, VoxelsPerSide - 2);
-            int32 Z = FMath::Clamp(FMath::FloorToInt(Coord.Z), 0, VoxelsPerSide - 2);
-            
-            // 三线性插值
-            double u = FMath::Clamp(Coord.X - X, 0.0, 1.0);
-            double v = FMath::Clamp(Coord.Y - Y, 0.0, 1.0);
-            double w = FMath::Clamp(Coord.Z - Z, 0.0, 1.0);
-            
-            auto GetVoxel = [&](int32 dx, int32 dy, int32 dz) -> float
-            {
-                int32 Index = (Z + dz) * VoxelsPerSide * VoxelsPerSide + 
-                             (Y + dy) * VoxelsPerSide + (X + dx);
-                return (Index >= 0 && Index < Node.Voxels.Num()) ? Node.Voxels[Index] : 1.0f;
-            };
-            
-            float v000 = GetVoxel(0, 0, 0);
-            float v100 = GetVoxel(1, 0, 0);
-            float v010 = GetVoxel(0, 1, 0);
-            float v110 = GetVoxel(1, 1, 0);
-            float v001 = GetVoxel(0, 0, 1);
-            float v101 = GetVoxel(1, 0, 1);
-            float v011 = GetVoxel(0, 1, 1);
-            float v111 = GetVoxel(1, 1, 1);
-            
-            float x00 = FMath::Lerp(v000, v100, u);
-            float x10 = FMath::Lerp(v010, v110, u);
-            float x01 = FMath::Lerp(v001, v101, u);
-            float x11 = FMath::Lerp(v011, v111, u);
-            
-            float y0 = FMath::Lerp(x00, x10, v);
-            float y1 = FMath::Lerp(x01, x11, v);
-            
-            return FMath::Lerp(y0, y1, w);
+    if (!IsValid() || !Bounds.Contains(WorldPos)) return 1.0f;
+
+    // 定位采样点所在的体素单元
+    FVector3d Coord = (WorldPos - Bounds.Min) / VoxelSize;
+    FIntVector SampleDims = GetSampleDims();
+    int32 X = FMath::Clamp(FMath::FloorToInt(Coord.X), 0, SampleDims.X - 2);
+    int32 Y = FMath::Clamp(FMath::FloorToInt(Coord.Y), 0, SampleDims.Y - 2);
+    int32 Z = FMath::Clamp(FMath::FloorToInt(Coord.Z), 0, SampleDims.Z - 2);
+
+    double u = FMath::Clamp(Coord.X - X, 0.0, 1.0);
+    double v = FMath::Clamp(Coord.Y - Y, 0.0, 1.0);
+    double w = FMath::Clamp(Coord.Z - Z, 0.0, 1.0);
+
+    float Corners[8];
+    int32 LX = X % BrickSize;
+    int32 LY = Y % BrickSize;
+    int32 LZ = Z % BrickSize;
+    if (LX < BrickSize - 1 && LY < BrickSize - 1 && LZ < BrickSize - 1)
+    {
+        // 8个角点都在同一个砖块内：一次查表
+        const FVoxelBrickCell& Cell = BrickTable[GetBrickLinearIndex(FIntVector(X / BrickSize, Y / BrickSize, Z / BrickSize))];
+        if (!Cell.IsAllocated())
+        {
+            // 细单元位于某个父级单元内，父级插值与先插值到细格点再插值的结果相同
+            return Cell.IsFromParent() ? Parent->GetValueAtPosition(ClampToParentBounds(WorldPos)) : Cell.UniformValue;
         }
-        else
+
+        const uint8* Data = BrickPool.GetData() + Cell.PoolIndex * GetBrickStride();
+        int32 Base = GetLocalVoxelIndex(LX, LY, LZ);
+        switch (StorageFormat)
+        {
+        case EVoxelStorageFormat::Int16:
+            GatherCellCorners(reinterpret_cast<const int16*>(Data), Base, BrickScales[Cell.PoolIndex], Corners);
+            break;
+        case EVoxelStorageFormat::Int8:
+            GatherCellCorners(reinterpret_cast<const int8*>(Data), Base, BrickScales[Cell.PoolIndex], Corners);
+            break;
+        default:
+            GatherCellCorners(reinterpret_cast<const float*>(Data), Base, 1.0f, Corners);
+            break;
+        }
+    }
+    else
+    {
+        // 跨越砖块边界：逐个角点查表
+        for (int32 i = 0; i < 8; i++)
+        {
+            Corners[i] = GetSample(X + (i & 1), Y + ((i >> 1) & 1), Z + ((i >> 2) & 1));
+        }
+    }
+
+    return TrilinearInterpolate(Corners, u, v, w);
+}
+
+const float* FMaVoxelAccessor::SelectBrick(int32 BX, int32 BY, int32 BZ)
+{
+    if (CachedBrick.X != BX || CachedBrick.Y != BY || CachedBrick.Z != BZ)
+    {
+        CachedBrick = FIntVector(BX, BY, BZ);
+        const FVoxelBrickCell& Cell = Voxels.GetBrickCell(CachedBrick);
+        CachedUniform = Cell.UniformValue;
+        CachedValues = Voxels.ReadCell(CachedBrick, DecodeScratch);
+    }
+    return CachedValues;
+}
+
+float FMaVoxelAccessor::GetSample(int32 X, int32 Y, int32 Z)
+{
+    const int32 BrickSize = FMaVoxelData::BrickSize;
+    const float* Values = SelectBrick(X / BrickSize, Y / BrickSize, Z / BrickSize);
+    return Values ? Values[FMaVoxelData::GetLocalVoxelIndex(X % BrickSize, Y % BrickSize, Z % BrickSize)] : CachedUniform;
+}
+
+void FMaVoxelAccessor::GetCellCorners(int32 X, int32 Y, int32 Z, float OutCorners[8])
+{
+    const int32 BrickSize = FMaVoxelData::BrickSize;
+    int32 LX = X % BrickSize;
+    int32 LY = Y % BrickSize;
+    int32 LZ = Z % BrickSize;
+    if (LX < BrickSize - 1 && LY < BrickSize - 1 && LZ < BrickSize - 1)
+    {
+        // 8个角点都在同一个砖块内
+        const float* Values = SelectBrick(X / BrickSize, Y / BrickSize, Z / BrickSize);
+        if (!Values)
         {
-            // 查询子节点
-            for (const FOctreeNode& Child : Node.Children)
+            for (int32 i = 0; i < 8; i++)
             {
-                if (Child.ContainsPoint(Point))
-                {
-                    return QueryNode(Child, Point);
-                }
+                OutCorners[i] = CachedUniform;
             }
-            return 1.0f;
+            return;
         }
-    };
-    
-    return QueryNode(OctreeRoot, WorldPos);
+        GatherCellCorners(Values, FMaVoxelData::GetLocalVoxelIndex(LX, LY, LZ), 1.0f, OutCorners);
+        return;
+    }
+
+    // 跨越砖块边界：按角点顺序访问，相邻角点通常仍命中缓存
+    for (int32 i = 0; i < 8; i++)
+    {
+        OutCorners[i] = GetSample(X + (i & 1), Y + ((i >> 1) & 1), Z + ((i >> 2) & 1));
+    }
+}
+
+float FMaVoxelAccessor::GetValueAtPosition(const FVector3d& Pos)
+{
+    if (!Voxels.IsValid() || !Voxels.Bounds.Contains(Pos)) return 1.0f;
+
+    FVector3d Coord = (Pos - Voxels.Bounds.Min) / Voxels.VoxelSize;
+    FIntVector SampleDims = Voxels.GetSampleDims();
+    int32 X = FMath::Clamp(FMath::FloorToInt(Coord.X), 0, SampleDims.X - 2);
+    int32 Y = FMath::Clamp(FMath::FloorToInt(Coord.Y), 0, SampleDims.Y - 2);
+    int32 Z = FMath::Clamp(FMath::FloorToInt(Coord.Z), 0, SampleDims.Z - 2);
+
+    float Corners[8];
+    GetCellCorners(X, Y, Z, Corners);
+    return TrilinearInterpolate(Corners,
+        FMath::Clamp(Coord.X - X, 0.0, 1.0), FMath::Clamp(Coord.Y - Y, 0.0, 1.0), FMath::Clamp(Coord.Z - Z, 0.0, 1.0));
+}
+
+void FMaVoxelAccessor::GetValuesAtPositions(TArrayView<const FVector3d> Positions, TArrayView<float> OutValues)
+{
+    check(OutValues.Num() >= Positions.Num());
+    for (int32 i = 0; i < Positions.Num(); i++)
+    {
+        OutValues[i] = GetValueAtPosition(Positions[i]);
+    }
 }
 
-void FMaVoxelData::UpdateRegion(const FAxisAlignedBox3d& UpdateBounds,
-	const TFunctionRef<float(const FVector3d&)>& UpdateFunction)
+void FMaVoxelData::GetValuesAtPositions(TArrayView<const FVector3d> Positions, TArrayView<float> OutValues) const
 {
-    TFunction<void(FOctreeNode&)> UpdateNode = [&](FOctreeNode& Node)
+    check(OutValues.Num() >= Positions.Num());
+    if (!IsValid())
+    {
+        for (int32 i = 0; i < Positions.Num(); i++)
+        {
+            OutValues[i] = 1.0f;
+        }
+        return;
+    }
+
+    constexpr int32 StrideY = BrickSize;
+    constexpr int32 StrideZ = BrickSize * BrickSize;
+    constexpr int32 CornerOffsets[8] = { 0, 1, StrideY, StrideY + 1, StrideZ, StrideZ + 1, StrideZ + StrideY, StrideZ + StrideY + 1 };
+    const FIntVector SampleDims = GetSampleDims();
+
+    // 每块的中间数据按 SoA 排列，便于 SIMD 读取
+    alignas(16) float Corners[8][SampleBatchSize];
+    alignas(16) float U[SampleBatchSize];
+    alignas(16) float V[SampleBatchSize];
+    alignas(16) float W[SampleBatchSize];
+    FIntVector Cells[SampleBatchSize];
+    float Scratch[BrickVoxelCount];
+    TArray<uint64, TInlineAllocator<SampleBatchSize>> Order;   // 高 32 位为砖块索引，低 32 位为块内序号
+
+    for (int32 BatchStart = 0; BatchStart < Positions.Num(); BatchStart += SampleBatchSize)
     {
-        if (!Node.IntersectsBounds(UpdateBounds)) return;
-        
-        if (Node.bIsLeaf)
+        const int32 Count = FMath::Min(SampleBatchSize, Positions.Num() - BatchStart);
+
+        // 1. 定位每个采样所在的单元和插值系数
+        Order.Reset();
+        for (int32 i = 0; i < Count; i++)
+        {
+            const FVector3d& Pos = Positions[BatchStart + i];
+            if (!Bounds.Contains(Pos))
+            {
+                // 范围外：角点全部取 1，插值结果也是 1
+                for (int32 c = 0; c < 8; c++)
+                {
+                    Corners[c][i] = 1.0f;
+                }
+                U[i] = V[i] = W[i] = 0.0f;
+                continue;
+            }
+
+            FVector3d Coord = (Pos - Bounds.Min) / VoxelSize;
+            int32 X = FMath::Clamp(FMath::FloorToInt(Coord.X), 0, SampleDims.X - 2);
+            int32 Y = FMath::Clamp(FMath::FloorToInt(Coord.Y), 0, SampleDims.Y - 2);
+            int32 Z = FMath::Clamp(FMath::FloorToInt(Coord.Z), 0, SampleDims.Z - 2);
+            U[i] = (float)FMath::Clamp(Coord.X - X, 0.0, 1.0);
+            V[i] = (float)FMath::Clamp(Coord.Y - Y, 0.0, 1.0);
+            W[i] = (float)FMath::Clamp(Coord.Z - Z, 0.0, 1.0);
+            Cells[i] = FIntVector(X, Y, Z);
+
+            int32 BrickLinear = GetBrickLinearIndex(FIntVector(X / BrickSize, Y / BrickSize, Z / BrickSize));
+            Order.Add(((uint64)BrickLinear << 32) | (uint32)i);
+        }
+
+        // 2. 按砖块分组取角点，每个砖块只查表和解码一次
+        Algo::Sort(Order);
+        for (int32 k = 0; k < Order.Num();)
         {
-            if (Node.bIsEmpty) return;
-            
-            // 更新叶子节点内的体素
-            int32 VoxelsPerSide = Node.VoxelsPerSide;
-            if (VoxelsPerSide <= 1) return;
-            
-            FVector3d VoxelSizeLeaf = (Node.Bounds.Max - Node.Bounds.Min) / (VoxelsPerSide - 1);
-            bool bBecameNonEmpty = false;
-            
-            for (int32 Z = 0; Z < VoxelsPerSide; Z++)
+            const uint32 BrickLinear = (uint32)(Order[k] >> 32);
+            const FVoxelBrickCell& Cell = BrickTable[BrickLinear];
+            const FIntVector& FirstCell = Cells[(int32)(uint32)Order[k]];
+            const float* BrickValues = ReadCell(FIntVector(FirstCell.X / BrickSize, FirstCell.Y / BrickSize, FirstCell.Z / BrickSize), Scratch);
+
+            for (; k < Order.Num() && (uint32)(Order[k] >> 32) == BrickLinear; k++)
             {
-                for (int32 Y = 0; Y < VoxelsPerSide; Y++)
+                const int32 i = (int32)(uint32)Order[k];
+                const FIntVector& CellCoord = Cells[i];
+                int32 LX = CellCoord.X % BrickSize;
+                int32 LY = CellCoord.Y % BrickSize;
+                int32 LZ = CellCoord.Z % BrickSize;
+                if (LX < BrickSize - 1 && LY < BrickSize - 1 && LZ < BrickSize - 1)
                 {
-                    for (int32 X = 0; X < VoxelsPerSide; X++)
+                    int32 Base = GetLocalVoxelIndex(LX, LY, LZ);
+                    for (int32 c = 0; c < 8; c++)
                     {
-                        FVector3d LocalPos = FVector3d(X, Y, Z) * VoxelSizeLeaf;
-                        FVector3d WorldPos = Node.Bounds.Min + LocalPos;
-                        
-                        if (UpdateBounds.Contains(WorldPos))
-                        {
-                            float NewValue = UpdateFunction(WorldPos);
-                            int32 Index = Z * VoxelsPerSide * VoxelsPerSide + Y * VoxelsPerSide + X;
-                            
-                            if (Index >= 0 && Index < Node.Voxels.Num())
-                            {
-                                Node.Voxels[Index] = NewValue;
-                                
-                                // 检查节点是否变为非空
-                                if (FMath::Abs(NewValue) < Node.Bounds.Extents().GetMax() * 2.0)
-                                {
-                                    bBecameNonEmpty = true;
-                                }
-                            }
-                        }
+                        Corners[c][i] = BrickValues ? BrickValues[Base + CornerOffsets[c]] : Cell.UniformValue;
+                    }
+                }
+                else
+                {
+                    // 跨越砖块边界的单元逐个角点查表
+                    for (int32 c = 0; c < 8; c++)
+                    {
+                        Corners[c][i] = GetSample(CellCoord.X + (c & 1), CellCoord.Y + ((c >> 1) & 1), CellCoord.Z + ((c >> 2) & 1));
                     }
                 }
             }
-            
-            if (bBecameNonEmpty)
+        }
+
+        // 3. 三线性插值（ISPC 或 4 路 SIMD）
+        VoxelKernels::TrilinearBatch(&Corners[0][0], SampleBatchSize, U, V, W, OutValues.GetData() + BatchStart, Count);
+    }
+}
+
+int64 FMaVoxelData::UpdateRegion(const FAxisAlignedBox3d& UpdateBounds,
+	const TFunctionRef<void(TArrayView<const FVector3d>, TArrayView<float>)>& UpdateFunction, bool bIncludeEmptyBricks)
+{
+    if (!IsValid()) return 0;
+
+    // 计算受影响的采样点范围
+    FVector3d MinCoord = (UpdateBounds.Min - Bounds.Min) / VoxelSize;
+    FVector3d MaxCoord = (UpdateBounds.Max - Bounds.Min) / VoxelSize;
+    FIntVector SampleDims = GetSampleDims();
+    FIntVector SampleMin(
+        FMath::Max(0, FMath::CeilToInt32(MinCoord.X)),
+        FMath::Max(0, FMath::CeilToInt32(MinCoord.Y)),
+        FMath::Max(0, FMath::CeilToInt32(MinCoord.Z)));
+    FIntVector SampleMax(
+        FMath::Min(SampleDims.X - 1, FMath::FloorToInt32(MaxCoord.X)),
+        FMath::Min(SampleDims.Y - 1, FMath::FloorToInt32(MaxCoord.Y)),
+        FMath::Min(SampleDims.Z - 1, FMath::FloorToInt32(MaxCoord.Z)));
+    if (SampleMin.X > SampleMax.X || SampleMin.Y > SampleMax.Y || SampleMin.Z > SampleMax.Z)
+    {
+        return 0;
+    }
+
+    // 先收集受影响的砖块：已分配砖块直接更新；实心均匀砖块可能被切开，和继承父级的砖块一起单独处理；
+    // 空砖块只有在更新可能生成材料时才参与
+    FIntVector BrickMin = SampleMin / BrickSize;
+    FIntVector BrickMax = SampleMax / BrickSize;
+    TArray<FIntVector> AffectedBricks;
+    TArray<FIntVector> UniformBricks;
+    for (int32 BZ = BrickMin.Z; BZ <= BrickMax.Z; BZ++)
+    {
+        for (int32 BY = BrickMin.Y; BY <= BrickMax.Y; BY++)
+        {
+            for (int32 BX = BrickMin.X; BX <= BrickMax.X; BX++)
             {
-                Node.bIsEmpty = false;
+                FIntVector BrickCoord(BX, BY, BZ);
+                const FVoxelBrickCell& Cell = GetBrickCell(BrickCoord);
+                if (Cell.IsAllocated())
+                {
+                    AffectedBricks.Add(BrickCoord);
+                }
+                else if (Cell.IsFromParent() || Cell.UniformValue < 0.0f || bIncludeEmptyBricks)
+                {
+                    UniformBricks.Add(BrickCoord);
+                }
             }
         }
-        else
+    }
+
+    // 更新一个砖块内与更新范围相交的采样点，返回被修改的体素数量
+    auto UpdateBrick = [&](const FIntVector& BrickCoord, float* Voxels) -> int64
+    {
+        FIntVector Origin = BrickCoord * BrickSize;
+        int32 X0 = FMath::Max(SampleMin.X - Origin.X, 0), X1 = FMath::Min(SampleMax.X - Origin.X, BrickSize - 1);
+        int32 Y0 = FMath::Max(SampleMin.Y - Origin.Y, 0), Y1 = FMath::Min(SampleMax.Y - Origin.Y, BrickSize - 1);
+        int32 Z0 = FMath::Max(SampleMin.Z - Origin.Z, 0), Z1 = FMath::Min(SampleMax.Z - Origin.Z, BrickSize - 1);
+
+        // 收集采样点交给 UpdateFunction 整批处理，再写回并统计变化
+        FVector3d Positions[BrickVoxelCount];
+        alignas(16) float Values[BrickVoxelCount];
+        int32 Count = 0;
+        for (int32 Z = Z0; Z <= Z1; Z++)
         {
-            for (FOctreeNode& Child : Node.Children)
+            for (int32 Y = Y0; Y <= Y1; Y++)
             {
-                UpdateNode(Child);
+                for (int32 X = X0; X <= X1; X++)
+                {
+                    Positions[Count] = GetSamplePosition(Origin.X + X, Origin.Y + Y, Origin.Z + Z);
+                    Values[Count] = Voxels[GetLocalVoxelIndex(X, Y, Z)];
+                    Count++;
+                }
             }
-            
-            // 更新后重新检查子节点是否都为空
-            Node.bIsEmpty = true;
-            for (const FOctreeNode& Child : Node.Children)
+        }
+
+        UpdateFunction(TArrayView<const FVector3d>(Positions, Count), TArrayView<float>(Values, Count));
+
+        int64 BrickChanged = 0;
+        int32 Index = 0;
+        for (int32 Z = Z0; Z <= Z1; Z++)
+        {
+            for (int32 Y = Y0; Y <= Y1; Y++)
             {
-                if (!Child.bIsEmpty)
+                for (int32 X = X0; X <= X1; X++)
                 {
-                    Node.bIsEmpty = false;
-                    break;
+                    float& Value = Voxels[GetLocalVoxelIndex(X, Y, Z)];
+                    BrickChanged += (Values[Index] != Value) ? 1 : 0;
+                    Value = Values[Index++];
                 }
             }
         }
+        return BrickChanged;
     };
-    
-    UpdateNode(OctreeRoot);
-}
 
-void FMaVoxelData::DebugLogOctreeStats() const
-{
-    int32 LeafCount = 0;
-    int32 NonEmptyLeafCount = 0;
-    int32 TotalVoxels = 0;
-    
-    TFunction<void(const FOctreeNode&)> CountNodes = [&](const FOctreeNode& Node)
+    // 砖块之间互不重叠，可以并行更新
+    std::atomic<int64> ChangedVoxels(0);
+    ParallelFor(AffectedBricks.Num(), [&](int32 Index)
     {
-        if (Node.bIsLeaf)
+        const FIntVector& BrickCoord = AffectedBricks[Index];
+        int32 PoolIndex = GetBrickCell(BrickCoord).PoolIndex;
+        int64 BrickChanged = 0;
+        if (IsQuantized())
         {
-            LeafCount++;
-            if (!Node.bIsEmpty) 
+            // 量化格式：解码到局部缓冲中更新，有修改时重新编码
+            float Scratch[BrickVoxelCount];
+            ReadBrick(PoolIndex, Scratch);
+            BrickChanged = UpdateBrick(BrickCoord, Scratch);
+            if (BrickChanged > 0)
             {
-                NonEmptyLeafCount++;
-                TotalVoxels += Node.Voxels.Num();
+                WriteBrick(PoolIndex, Scratch);
             }
         }
         else
         {
-            for (const FOctreeNode& Child : Node.Children)
+            BrickChanged = UpdateBrick(BrickCoord, GetBrickVoxels(PoolIndex));
+        }
+
+        // 每个砖块只做一次原子累加
+        if (BrickChanged > 0)
+        {
+            ChangedVoxels += BrickChanged;
+        }
+    });
+
+    // 均匀砖块先在临时缓冲中以常量值展开（继承父级的砖块从父级插值）并更新，只有真正被修改的才分配到砖块池
+    if (UniformBricks.Num() > 0)
+    {
+        TArray<float> UniformScratch;
+        UniformScratch.SetNumUninitialized(UniformBricks.Num() * BrickVoxelCount);
+        TArray<int64> UniformChanged;
+        UniformChanged.SetNumZeroed(UniformBricks.Num());
+
+        ParallelFor(UniformBricks.Num(), [&](int32 Index)
+        {
+            const FIntVector& BrickCoord = UniformBricks[Index];
+            float* Voxels = UniformScratch.GetData() + (int64)Index * BrickVoxelCount;
+            const FVoxelBrickCell& Cell = GetBrickCell(BrickCoord);
+            if (Cell.IsFromParent())
+            {
+                ResampleFromParent(BrickCoord, Voxels);
+            }
+            else
+            {
+                for (int32 i = 0; i < BrickVoxelCount; i++)
+                {
+                    Voxels[i] = Cell.UniformValue;
+                }
+            }
+            UniformChanged[Index] = UpdateBrick(BrickCoord, Voxels);
+        });
+
+        int32 NumChangedBricks = 0;
+        for (int64 BrickChanged : UniformChanged)
+        {
+            NumChangedBricks += (BrickChanged > 0) ? 1 : 0;
+        }
+        ReserveBricks(NumChangedBricks);
+        for (int32 Index = 0; Index < UniformBricks.Num(); Index++)
+        {
+            if (UniformChanged[Index] > 0)
             {
-                CountNodes(Child);
+                AllocateBrick(UniformBricks[Index], UniformScratch.GetData() + (int64)Index * BrickVoxelCount);
+                ChangedVoxels += UniformChanged[Index];
             }
         }
-    };
-    
-    CountNodes(OctreeRoot);
-    
-    UE_LOG(LogTemp, Warning, TEXT("八叉树统计: 总叶子节点=%d, 非空叶子=%d, 存储体素数=%d"), 
-           LeafCount, NonEmptyLeafCount, TotalVoxels);
+    }
+
+    return ChangedVoxels;
+}
+
+void FMaVoxelData::DebugLogOctreeStats() const
+{
+    int32 BrickCount = BrickTable.Num();
+    int32 AllocatedBrickCount = GetNumAllocatedBricks();
+    int64 TotalVoxels = (int64)AllocatedBrickCount * BrickVoxelCount;
+    double PoolMemoryMB = (BrickPool.GetAllocatedSize() + BrickScales.GetAllocatedSize() + BrickTable.GetAllocatedSize()
+        + BrickCoords.GetAllocatedSize() + FreeBrickSlots.GetAllocatedSize()) / (1024.0 * 1024.0);
+
+    UE_LOG(LogTemp, Warning, TEXT("砖块网格统计: 网格=%s, 总砖块=%d, 已分配砖块=%d, 存储体素数=%lld, 每体素字节=%d, 体素间距=%.3f, 内存=%.2f MB"),
+           *BrickDims.ToString(), BrickCount, AllocatedBrickCount, TotalVoxels, GetBytesPerVoxel(), VoxelSize, PoolMemoryMB);
+
+    if (IsRefined())
+    {
+        int32 ParentBrickCount = 0;
+        for (const FVoxelBrickCell& Cell : BrickTable)
+        {
+            ParentBrickCount += Cell.IsFromParent() ? 1 : 0;
+        }
+        UE_LOG(LogTemp, Warning, TEXT("按需细化: 倍数=%d, 父级体素间距=%.3f, 仍继承父级的砖块=%d, 父级已分配砖块=%d"),
+               RefineFactor, Parent->VoxelSize, ParentBrickCount, Parent->GetNumAllocatedBricks());
+    }
 }
 
 float FMaVoxelData::CalculateDistanceToMesh(const FDynamicMeshAABBTree3& Spatial,
 	TFastWindingTree<FDynamicMesh3>& Winding, const FVector3d& Pos) const
-{    
+{
     // 使用AABB树查找最近三角形
-    double NearestDistSqr; 
+    double NearestDistSqr;
     int32 NearestTriID = Spatial.FindNearestTriangle(Pos, NearestDistSqr);
-    
+
     if (NearestTriID == IndexConstants::InvalidID)
     {
         return TNumericLimits<float>::Max(); // 没有找到三角形，返回最大距离
     }
     double NearestDist = FMath::Sqrt(NearestDistSqr);
-    
+
     // 使用绕数法判断点在网格内部还是外部
     bool bIsInside = Winding.IsInside(Pos);
-    
+
     // 内部点距离为负，外部点距离为正
     float SignedDistance = bIsInside ? -NearestDist : NearestDist;
-    
+
     return (float)SignedDistance;
 }
-UE_ENABLE_OPTIMIZATION
\ No newline at end of file
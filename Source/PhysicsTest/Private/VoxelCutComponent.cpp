@@ -3,6 +3,7 @@
 
 #include "VoxelCutComponent.h"
 
+#include "VoxelCutSubsystem.h"
 #include "DynamicMesh/MeshTransforms.h"
 #include "Engine/Engine.h"
 
@@ -12,7 +13,6 @@ UVoxelCutComponent::UVoxelCutComponent()
 	PrimaryComponentTick.bCanEverTick = true;
 	PrimaryComponentTick.TickGroup = TG_PostPhysics;
     
-	CutState = ECutState::Idle;
 	bIsCutting = false;
 	DistanceSinceLastUpdate = 0.0f;	
 }
@@ -20,6 +20,18 @@ UVoxelCutComponent::UVoxelCutComponent()
 void UVoxelCutComponent::BeginPlay()
 {
 	Super::BeginPlay();
+
+	if (bUseCutScheduler)
+	{
+		UWorld* World = GetWorld();
+		if (UVoxelCutSubsystem* Scheduler = World ? World->GetSubsystem<UVoxelCutSubsystem>() : nullptr)
+		{
+			// 由子系统统一推进，组件自身不再 Tick
+			Scheduler->RegisterCutComponent(this);
+			CutScheduler = Scheduler;
+			SetComponentTickEnabled(false);
+		}
+	}
 }
 
 
@@ -28,12 +40,47 @@ void UVoxelCutComponent::TickComponent(float DeltaTime, ELevelTick TickType,
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
+	TickCut(true);
+}
+
+void UVoxelCutComponent::TickCut(bool bToolNearTarget)
+{
 	if (!bIsCutting || !CutToolMeshComponent || !TargetMeshComponent)
+	{
+		// 停止切削后仍要处理完已积累的请求
+		UpdateStateMachine();
 		return;
+	}
 
-	// 获取当前工具位置
-	FTransform CurrentTransform = CutToolMeshComponent->GetComponentTransform();
-	
+	// 获取工具相对于目标的位姿（体素数据在目标局部空间，目标移动时同样需要切削）
+	FTransform CurrentTransform = CutToolMeshComponent->GetComponentTransform()
+		.GetRelativeTransform(TargetMeshComponent->GetComponentTransform());
+
+	if (!bToolNearTarget)
+	{
+		// 刚离开目标的这一步仍要切削，之后只记下最近的位姿
+		if (bToolWasNearTarget)
+		{
+			RequestCut(CurrentTransform);
+		}
+		bToolWasNearTarget = false;
+		ToolOutsidePose = CurrentTransform;
+		bHasToolOutsidePose = true;
+
+		DistanceSinceLastUpdate = 0.0f;
+		LastToolPosition = CurrentTransform.GetLocation();
+		LastToolRotation = CurrentTransform.GetRotation().Rotator();
+		UpdateStateMachine();
+		return;
+	}
+
+	if (!bToolWasNearTarget && bHasToolOutsidePose)
+	{
+		// 重新靠近目标：从目标外的最后一个位姿开始新的一段扫掠，不与离开前的行程相连
+		RequestCut(ToolOutsidePose, true);
+		bHasToolOutsidePose = false;
+	}
+	bToolWasNearTarget = true;
 	
 	// 检查是否需要切削更新
 	if (NeedsCutUpdate(CurrentTransform))
@@ -61,14 +108,22 @@ void UVoxelCutComponent::StartCutting()
 {
 	bIsCutting = true;
     
-	// 记录初始工具位置
-	if (CutToolMeshComponent)
+	// 记录初始工具位置（相对于目标）
+	if (CutToolMeshComponent && TargetMeshComponent)
 	{
-		LastToolPosition = CutToolMeshComponent->GetComponentLocation();
-		LastToolRotation = CutToolMeshComponent->GetComponentRotation();
+		FTransform RelativeTransform = CutToolMeshComponent->GetComponentTransform()
+			.GetRelativeTransform(TargetMeshComponent->GetComponentTransform());
+		LastToolPosition = RelativeTransform.GetLocation();
+		LastToolRotation = RelativeTransform.GetRotation().Rotator();
 	}
     
 	DistanceSinceLastUpdate = 0.0f;
+	bToolWasNearTarget = false;
+	bHasToolOutsidePose = false;
+
+	// 重新开始切削时不与上一段行程连接
+	FScopeLock Lock(&StateLock);
+	bHasLastCutToolTransform = false;
 }
 
 void UVoxelCutComponent::StopCutting()
@@ -78,9 +133,14 @@ void UVoxelCutComponent::StopCutting()
 
 
 
-void UVoxelCutComponent::OnCutComplete(FDynamicMesh3* ResultMesh)
+void UVoxelCutComponent::OnCutComplete(TUniquePtr<FDynamicMesh3> ResultMesh, TArray<FVoxelMeshSection> Sections)
 {
-	if (ResultMesh && ResultMesh->TriangleCount() > 0)
+	bool bSwappedIn = false;
+	if (Sections.Num() > 0)
+	{
+		ApplySections(Sections);
+	}
+	else if (ResultMesh.IsValid() && ResultMesh->TriangleCount() > 0)
 	{
 		// 更新结果网格
 		if (TargetMeshComponent)
@@ -88,26 +148,106 @@ void UVoxelCutComponent::OnCutComplete(FDynamicMesh3* ResultMesh)
 			UDynamicMesh* DynamicMesh = TargetMeshComponent->GetDynamicMesh();
 			if (DynamicMesh)
 			{
-				DynamicMesh->SetMesh(*ResultMesh);    
-				TargetMeshComponent->NotifyMeshUpdated(); 
+				// 与组件内的网格交换而不是复制，EditMesh 会通知组件更新渲染数据
+				DynamicMesh->EditMesh([&ResultMesh](FDynamicMesh3& EditMesh)
+				{
+					Swap(EditMesh, *ResultMesh);
+				});
+				bSwappedIn = true;
 			}
 		}
 	}
+
+	// 换出的旧网格归还缓冲环，供下一次生成使用
+	if (CutOp.IsValid())
+	{
+		CutOp->ReleaseResultBuffer(MoveTemp(ResultMesh), bSwappedIn);
+	}
     
-	// 更新状态
+	// 结果已交给组件，阶段二可以处理下一个快照
+	FScopeLock Lock(&StateLock);
+	bMeshStageBusy = false;
+	UpdateStateMachine();
+}
+
+void UVoxelCutComponent::ApplySections(TArray<FVoxelMeshSection>& Sections)
+{
+	if (!TargetMeshComponent)
+		return;
+
+	// 分段接管显示后隐藏原始网格
+	if (TargetMeshComponent->IsVisible())
+	{
+		TargetMeshComponent->SetVisibility(false);
+	}
+
+	for (FVoxelMeshSection& Section : Sections)
+	{
+		if (!Section.Mesh.IsValid())
+			continue;
+
+		UDynamicMeshComponent* SectionComponent = nullptr;
+		if (UDynamicMeshComponent** Found = SectionComponents.Find(Section.ChunkIndex))
+		{
+			SectionComponent = *Found;
+		}
+		else if (Section.Mesh->TriangleCount() > 0)
+		{
+			SectionComponent = GetOrCreateSectionComponent(Section.ChunkIndex);
+		}
+		if (!SectionComponent)
+			continue;
+
+		// 每个分段只重建自己的渲染数据
+		SectionComponent->GetDynamicMesh()->EditMesh([&Section](FDynamicMesh3& EditMesh)
+		{
+			Swap(EditMesh, *Section.Mesh);
+		});
+	}
+}
+
+UDynamicMeshComponent* UVoxelCutComponent::GetOrCreateSectionComponent(int32 ChunkIndex)
+{
+	if (UDynamicMeshComponent** Found = SectionComponents.Find(ChunkIndex))
+	{
+		return *Found;
+	}
+
+	UDynamicMeshComponent* SectionComponent = NewObject<UDynamicMeshComponent>(GetOwner(), NAME_None, RF_Transient);
+	SectionComponent->SetupAttachment(TargetMeshComponent);
+	SectionComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	for (int32 MaterialIndex = 0; MaterialIndex < TargetMeshComponent->GetNumMaterials(); MaterialIndex++)
+	{
+		SectionComponent->SetMaterial(MaterialIndex, TargetMeshComponent->GetMaterial(MaterialIndex));
+	}
+	SectionComponent->RegisterComponent();
+
+	SectionComponents.Add(ChunkIndex, SectionComponent);
+	return SectionComponent;
+}
+
+void UVoxelCutComponent::OnVoxelStageComplete(FVoxelMeshSnapshot&& Snapshot, bool bSuccess)
+{
 	FScopeLock Lock(&StateLock);
-	CutState = ECutState::Completed;
+	bVoxelStageBusy = false;
+	if (bSuccess)
+	{
+		PendingSnapshot = MoveTemp(Snapshot);
+	}
+
+	// 立即推进，不必等到下一帧
+	UpdateStateMachine();
 }
 
 void UVoxelCutComponent::InitializeCutSystem()
 {
-	if (bSystemInitialized || !TargetMeshComponent || !CutToolMeshComponent)
+	if (bSystemInitialized || bInitializing || !TargetMeshComponent || !CutToolMeshComponent)
 		return;
     
 	// 创建切削操作器（只创建一次）
 	if (!CutOp.IsValid())
 	{
-		CutOp = MakeShared<FVoxelCutMeshOp>();
+		CutOp = MakeShared<FVoxelCutMeshOp, ESPMode::ThreadSafe>();
 	}
     
 	// 设置基础参数
@@ -119,33 +259,204 @@ void UVoxelCutComponent::InitializeCutSystem()
 	CutOp->MarchingCubeSize = MarchingCubeSize;
 	CutOp->MaxOctreeDepth = MaxOctreeDepth;
 	CutOp->MinVoxelSize = MinVoxelSize;
+	CutOp->CutVoxelSize = CutVoxelSize;
 	CutOp->CutToolMesh = CopyToolMesh();
+	CutOp->ToolShape = ToolShape;
+	CutOp->bOutputSections = bUseRenderSections;
+	CutOp->VoxelizeMethod = bFastVoxelization ? EVoxelizeMethod::Rasterize : EVoxelizeMethod::MeshQuery;
+	CutOp->bUseVoxelCache = bCacheVoxelData;
+	CutOp->VoxelStorageFormat = VoxelStorageFormat;
+	CutOp->bCollapseUniformBricks = bCollapseUniformBricks;
 	
     
 	// 获取目标网格数据
 	UDynamicMesh* TargetDynamicMesh = TargetMeshComponent->GetDynamicMesh();
-	if (TargetDynamicMesh)
+	if (!TargetDynamicMesh)
 	{
-		// 创建目标网格的副本（只做一次）
-		CutOp->TargetMesh = MakeShared<FDynamicMesh3>();
-		TargetDynamicMesh->ProcessMesh([this](const FDynamicMesh3& SourceMesh)
-		{
-			CutOp->TargetMesh->Copy(SourceMesh);
-		});
+		return;
+	}
+
+	// 创建目标网格的副本（只做一次，UDynamicMesh 只能在主线程读取）
+	CutOp->TargetMesh = MakeShared<FDynamicMesh3>();
+	TargetDynamicMesh->ProcessMesh([this](const FDynamicMesh3& SourceMesh)
+	{
+		CutOp->TargetMesh->Copy(SourceMesh);
+	});
         
-		// 设置目标变换
-		CutOp->TargetTransform = TargetMeshComponent->GetComponentTransform();
+	// 设置目标变换（只用于换算体素精度，体素数据在目标局部空间）
+	CutOp->TargetTransform = TargetMeshComponent->GetComponentTransform();
+
+	// 体素化和刀具距离场烘焙在后台线程进行
+	bInitializing = true;
+	VoxelLocalBounds = FBox(ForceInit);
+	TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe> CancelRequested = MakeShared<FThreadSafeBool, ESPMode::ThreadSafe>(false);
+	InitCancelRequested = CancelRequested;
+	InitProgress = MakeShared<FProgressCancel, ESPMode::ThreadSafe>();
+	InitProgress->CancelF = [CancelRequested]() { return (bool)*CancelRequested; };
+
+	TSharedPtr<FVoxelCutMeshOp, ESPMode::ThreadSafe> Op = CutOp;
+	TSharedPtr<FProgressCancel, ESPMode::ThreadSafe> Progress = InitProgress;
+	TWeakObjectPtr<UVoxelCutComponent> WeakThis(this);
+	DispatchJob([Op, Progress, WeakThis]()
+	{
+		double StartTime = FPlatformTime::Seconds();
 
 		// 体素化切割目标（只做一次）
-		CutOp->InitializeVoxelData(nullptr);
+		bool bSuccess = Op->InitializeVoxelData(Progress.Get());
 
-		
+		// 刀具是刚体，距离场在局部空间烘焙一次，后续切削只做查表（失败时回退到网格查询）
+		if (bSuccess)
+		{
+			FProgressCancel::FProgressScope ToolScope(Progress.Get(), 0.1f);
+			Op->InitializeToolSDF(Progress.Get());
+			ToolScope.Done();
+		}
+		bSuccess = bSuccess && !Progress->Cancelled();
+
+		UE_LOG(LogTemp, Warning, TEXT("切削系统后台初始化%s, 耗时: %.2f 毫秒"),
+			bSuccess ? TEXT("完成") : TEXT("失败或被取消"), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+
+		Async(EAsyncExecution::TaskGraphMainThread, [WeakThis, bSuccess]()
+		{
+			if (UVoxelCutComponent* This = WeakThis.Get())
+			{
+				This->OnInitializationComplete(bSuccess);
+			}
+		});
+	});
+}
+
+void UVoxelCutComponent::OnInitializationComplete(bool bSuccess)
+{
+	{
+		FScopeLock Lock(&StateLock);
+		bInitializing = false;
+		bSystemInitialized = bSuccess;
+		if (bSuccess && CutOp.IsValid() && CutOp->PersistentVoxelData.IsValid())
+		{
+			FAxisAlignedBox3d GridBounds = CutOp->PersistentVoxelData->GetOctreeBounds();
+			VoxelLocalBounds = FBox(FVector(GridBounds.Min), FVector(GridBounds.Max));
+		}
+		if (!bSuccess)
+		{
+			// 初始化失败：拒绝排队中的请求
+			PendingToolPath.Reset();
+		}
 	}
 
-	bSystemInitialized = true;
+	OnCutSystemInitialized.Broadcast(bSuccess);
 
 	//VisualizeOctreeNode();
 	//PrintOctreeDetails();
+
+	// 处理初始化期间排队的请求
+	UpdateStateMachine();
+}
+
+float UVoxelCutComponent::GetInitializationProgress() const
+{
+	if (bSystemInitialized)
+	{
+		return 1.0f;
+	}
+	return InitProgress.IsValid() ? InitProgress->GetProgress() : 0.0f;
+}
+
+void UVoxelCutComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// 后台任务持有操作器的共享引用，取消后自行结束，回调因组件已销毁而被忽略
+	if (bInitializing && InitCancelRequested.IsValid())
+	{
+		*InitCancelRequested = true;
+	}
+
+	// 还在排队的任务直接丢弃
+	if (UVoxelCutSubsystem* Scheduler = CutScheduler.Get())
+	{
+		Scheduler->UnregisterCutComponent(this);
+	}
+	CutScheduler.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UVoxelCutComponent::BenchmarkToolShape(int32 NumSamples)
+{
+	if (!bSystemInitialized || !CutOp.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("BenchmarkToolShape: 切削系统未初始化"));
+		return;
+	}
+	CutOp->BenchmarkToolDistance(NumSamples);
+}
+
+void UVoxelCutComponent::BenchmarkVoxelSampling(int32 NumSamples)
+{
+	if (!bSystemInitialized || !CutOp.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("BenchmarkVoxelSampling: 切削系统未初始化"));
+		return;
+	}
+	CutOp->BenchmarkVoxelSampling(NumSamples);
+}
+
+FBox UVoxelCutComponent::GetToolWorldBounds() const
+{
+	if (ToolShape.IsAnalytic())
+	{
+		FAxisAlignedBox3d LocalBounds = ToolShape.GetLocalBounds();
+		return FBox(FVector(LocalBounds.Min), FVector(LocalBounds.Max)).TransformBy(CutToolMeshComponent->GetComponentTransform());
+	}
+	return CutToolMeshComponent->Bounds.GetBox();
+}
+
+bool UVoxelCutComponent::IsToolNearTarget() const
+{
+	if (!CutToolMeshComponent || !TargetMeshComponent)
+	{
+		return false;
+	}
+
+	// 网格包围盒外的刀具仍可能影响体素（体素网格的外扩、平滑运算的过渡带），按这些范围扩展
+	// 两个包围盒都在世界空间，与操作器在局部空间使用的更新边界相同：外扩体素数 × 体素间距 + 过渡宽度
+	const int32 UpdateMargin = CutOp.IsValid() ? CutOp->UpdateMargin : 2;
+	const bool bSmooth = CutOperation == EVoxelCSGOperation::SmoothSubtract || CutOperation == EVoxelCSGOperation::SmoothUnion;
+	const double Margin = UpdateMargin * MarchingCubeSize + (bSmooth ? CSGSmoothness : 0.0) + UpdateThreshold;
+	return GetToolWorldBounds().Intersect(GetTargetWorldBounds().ExpandBy(Margin));
+}
+
+double UVoxelCutComponent::GetToolDistanceToTarget() const
+{
+	if (!CutToolMeshComponent || !TargetMeshComponent)
+	{
+		return TNumericLimits<double>::Max();
+	}
+	return FMath::Sqrt(GetTargetWorldBounds().ComputeSquaredDistanceToBox(GetToolWorldBounds()));
+}
+
+FBox UVoxelCutComponent::GetTargetWorldBounds() const
+{
+	if (!TargetMeshComponent)
+	{
+		return FBox(ForceInit);
+	}
+	if (VoxelLocalBounds.IsValid)
+	{
+		return VoxelLocalBounds.TransformBy(TargetMeshComponent->GetComponentTransform());
+	}
+	return TargetMeshComponent->Bounds.GetBox();
+}
+
+void UVoxelCutComponent::DispatchJob(TUniqueFunction<void()> Job)
+{
+	if (UVoxelCutSubsystem* Scheduler = CutScheduler.Get())
+	{
+		Scheduler->EnqueueJob(this, MoveTemp(Job));
+	}
+	else
+	{
+		Async(EAsyncExecution::ThreadPool, MoveTemp(Job));
+	}
 }
 
 bool UVoxelCutComponent::NeedsCutUpdate(const FTransform& InCurrentToolTransform)
@@ -159,78 +470,136 @@ bool UVoxelCutComponent::NeedsCutUpdate(const FTransform& InCurrentToolTransform
 void UVoxelCutComponent::UpdateStateMachine()
 {
 	FScopeLock Lock(&StateLock);
-    
-	switch (CutState)
-	{
-	case ECutState::Idle:		
-		break;        
-	case ECutState::RequestPending:
-		StartAsyncCut();		
-		break;        
-	case ECutState::Processing:
-		break;        
-	case ECutState::Completed:
-		CutState = ECutState::Idle;		
-		break;
+
+	// 先把等待中的快照交给阶段二，腾出快照槽位
+	if (!bMeshStageBusy && PendingSnapshot.IsValid())
+	{
+		StartAsyncMesh();
+	}
+
+	// 快照槽位为空时才开始阶段一，保证两个快照缓冲区不会被同时写入和读取
+	if (bSystemInitialized && !bVoxelStageBusy && !PendingSnapshot.IsValid() && PendingToolPath.Num() > 0)
+	{
+		StartAsyncCut();
 	}
 }
 
-void UVoxelCutComponent::RequestCut(const FTransform& ToolTransform)
+void UVoxelCutComponent::RequestCut(const FTransform& ToolTransform, bool bNewStroke)
 {
 	FScopeLock Lock(&StateLock);
     
-	// 保存当前请求数据
-	CurrentToolTransform = ToolTransform;
-	
-	//UE_LOG(LogTemp, Warning, TEXT("Cut State: %s"),*StaticEnum<ECutState>()->GetNameStringByValue((int64)CutState));
-	
-	// 只有在空闲状态或有新请求时才更新
-	if (CutState == ECutState::Idle || CutState == ECutState::Completed)
-	{		
-		CutState = ECutState::RequestPending;
-		//UE_LOG(LogTemp, Warning, TEXT("Request Pending"));
-	}
+	// 处理期间的请求不会被丢弃，而是加入路径，与之后的请求合并为一次扫掠
+	PendingToolPath.Add(FPendingCutPose{ToolTransform, CutOperation, CSGSmoothness, bNewStroke});
 }
 
 void UVoxelCutComponent::StartAsyncCut()
 {
 	FScopeLock Lock(&StateLock);
 	// 如果已经在处理，则退出
-	if (CutState==ECutState::Processing)
+	if (bVoxelStageBusy || PendingToolPath.Num() == 0)
 		return;
-	CutState = ECutState::Processing;
+	bVoxelStageBusy = true;
     
-    // 复制当前状态到局部变量（避免竞态条件）
-    FTransform LocalToolTransform = CurrentToolTransform;
-	
-    CutOp->CutToolTransform = LocalToolTransform;
+    // 本次只处理与第一个位姿运算相同的连续位姿，切换运算或开始新行程之后的位姿留给下一次
+    const FPendingCutPose& First = PendingToolPath[0];
+    int32 NumPoses = 1;
+    while (NumPoses < PendingToolPath.Num() && !PendingToolPath[NumPoses].bNewStroke &&
+           PendingToolPath[NumPoses].Operation == First.Operation && PendingToolPath[NumPoses].Smoothness == First.Smoothness)
+    {
+        NumPoses++;
+    }
+    CutOp->CutOperation = First.Operation;
+    CutOp->CSGSmoothness = First.Smoothness;
+
+    // 最后一个位姿为本次切削的终点，之前积累的位姿依次作为扫掠路点
+    CutOp->CutToolTransform = PendingToolPath[NumPoses - 1].Transform;
+    CutOp->SweepWaypoints.Reset();
+    if (bContinuousSweep && bHasLastCutToolTransform && !First.bNewStroke)
+    {
+        CutOp->SweepWaypoints.Add(LastCutToolTransform);
+    }
+    for (int32 i = 0; i < NumPoses - 1; i++)
+    {
+        CutOp->SweepWaypoints.Add(PendingToolPath[i].Transform);
+    }
+    LastCutToolTransform = CutOp->CutToolTransform;
+    bHasLastCutToolTransform = true;
+    PendingToolPath.RemoveAt(0, NumPoses, EAllowShrinking::No);
     
-    // 在异步线程中执行实际切削计算
-    Async(EAsyncExecution::ThreadPool, [this]()
+    // 在异步线程中更新体素（阶段二只读取快照，不会与这里冲突）
+    // 任务持有操作器的共享引用，回调通过弱引用访问组件，组件提前销毁时直接丢弃结果
+    TSharedPtr<FVoxelCutMeshOp, ESPMode::ThreadSafe> Op = CutOp;
+    TWeakObjectPtr<UVoxelCutComponent> WeakThis(this);
+    DispatchJob([Op, WeakThis]()
     {
+        FVoxelMeshSnapshot Snapshot;
+        bool bSuccess = false;
         try
         {
-            CutOp->CalculateResult(nullptr);
-            
-            // 切削完成，回到主线程
-            Async(EAsyncExecution::TaskGraphMainThread, [this]()
-            {
-                FDynamicMesh3* ResultMesh = CutOp->GetResultMesh();               
-                
-                OnCutComplete(ResultMesh);
-            });
+            bSuccess = Op->UpdateVoxelsStage(Snapshot, nullptr);
         }
         catch (const std::exception& e)
         {
             UE_LOG(LogTemp, Error, TEXT("Cut operation failed: %s"), UTF8_TO_TCHAR(e.what()));
-            
-            Async(EAsyncExecution::TaskGraphMainThread, [this]()
+        }
+
+        // 回到主线程交接快照
+        Async(EAsyncExecution::TaskGraphMainThread, [WeakThis, Snapshot = MoveTemp(Snapshot), bSuccess]() mutable
+        {
+            if (UVoxelCutComponent* This = WeakThis.Get())
+            {
+                This->OnVoxelStageComplete(MoveTemp(Snapshot), bSuccess);
+            }
+        });
+    });
+}
+
+void UVoxelCutComponent::StartAsyncMesh()
+{
+	FScopeLock Lock(&StateLock);
+	if (bMeshStageBusy || !PendingSnapshot.IsValid())
+		return;
+	bMeshStageBusy = true;
+
+	FVoxelMeshSnapshot Snapshot = MoveTemp(PendingSnapshot);
+	PendingSnapshot = FVoxelMeshSnapshot();
+
+    // 在异步线程中生成网格，结果的所有权随回调移交给组件
+    TSharedPtr<FVoxelCutMeshOp, ESPMode::ThreadSafe> Op = CutOp;
+    TWeakObjectPtr<UVoxelCutComponent> WeakThis(this);
+    DispatchJob([Op, WeakThis, Snapshot = MoveTemp(Snapshot)]()
+    {
+        TUniquePtr<FDynamicMesh3> ResultMesh;
+        TArray<FVoxelMeshSection> Sections;
+        try
+        {
+            Op->GenerateMeshStage(Snapshot, nullptr);
+            if (Op->bOutputSections)
+            {
+                Sections = Op->ExtractSections();
+            }
+            else
             {
-                // 即使失败也标记为完成
-                FScopeLock Lock(&StateLock);
-                CutState = ECutState::Completed;
-            });
+                ResultMesh = Op->ExtractResult();
+            }
+        }
+        catch (const std::exception& e)
+        {
+            UE_LOG(LogTemp, Error, TEXT("Mesh generation failed: %s"), UTF8_TO_TCHAR(e.what()));
         }
+
+        // 网格生成完成（失败时结果为空，同样释放阶段二），回到主线程
+        Async(EAsyncExecution::TaskGraphMainThread, [Op, WeakThis, ResultMesh = MoveTemp(ResultMesh), Sections = MoveTemp(Sections)]() mutable
+        {
+            if (UVoxelCutComponent* This = WeakThis.Get())
+            {
+                This->OnCutComplete(MoveTemp(ResultMesh), MoveTemp(Sections));
+            }
+            else
+            {
+                Op->ReleaseResultBuffer(MoveTemp(ResultMesh), false);
+            }
+        });
     });
 }
 
@@ -255,7 +624,7 @@ TSharedPtr<FDynamicMesh3> UVoxelCutComponent::CopyToolMesh()
 
 void UVoxelCutComponent::VisualizeOctreeNode()
 {
-	if (!CutOp || !CutOp->PersistentVoxelData.IsValid())
+	if (!bSystemInitialized || !CutOp || !CutOp->PersistentVoxelData.IsValid())
 	{
 		UE_LOG(LogTemp, Warning, TEXT("Voxel data is not valid for visualization"));
 		return;
@@ -263,70 +632,66 @@ void UVoxelCutComponent::VisualizeOctreeNode()
 	
 	// 清空之前的可视化
 	ClearOctreeVisualization();
+
+	const FMaVoxelData& VoxelData = *CutOp->PersistentVoxelData;
+	if (GetWorld())
+	{
+		// 绘制整个砖块网格的边界（目标局部空间）
+		FAxisAlignedBox3d GridBounds = VoxelData.GetOctreeBounds();
+		FTransform TargetToWorld = TargetMeshComponent ? TargetMeshComponent->GetComponentTransform() : FTransform::Identity;
+		DrawDebugBox(GetWorld(), TargetToWorld.TransformPosition(GridBounds.Center()), GridBounds.Extents() * TargetToWorld.GetScale3D(),
+			TargetToWorld.GetRotation(), FColor::Red, true, -1.0f, 0, 2.0f);
+	}
 	
-	// 递归遍历八叉树并绘制边界框
-	VisualizeOctreeNodeRecursive(CutOp->PersistentVoxelData->OctreeRoot, 0);
+	// 遍历已分配的砖块并绘制边界框
+	for (const FIntVector& BrickCoord : VoxelData.BrickCoords)
+	{
+		if (BrickCoord != FMaVoxelData::FreeSlotCoord)
+		{
+			VisualizeBrick(VoxelData, BrickCoord);
+		}
+	}
 	
 	UE_LOG(LogTemp, Log, TEXT("Octree visualization completed with %d boxes"), DebugBoxes.Num());
 }
 
-void UVoxelCutComponent::VisualizeOctreeNodeRecursive(const FOctreeNode& Node, int32 Depth)
+void UVoxelCutComponent::VisualizeBrick(const FMaVoxelData& VoxelData, const FIntVector& BrickCoord)
 {
 	if (!GetWorld())
 		return;
 	
-	// 根据节点深度选择颜色
-	FColor NodeColor;
-	switch (Depth % 6)
-	{
-	case 0: NodeColor = FColor::Red; break;
-	case 1: NodeColor = FColor::Green; break;
-	case 2: NodeColor = FColor::Blue; break;
-	case 3: NodeColor = FColor::Yellow; break;
-	case 4: NodeColor = FColor::Cyan; break;
-	case 5: NodeColor = FColor::Magenta; break;
-	default: NodeColor = FColor::White;
+	// 按砖块坐标交替选择颜色，便于区分相邻砖块
+	FColor BrickColor;
+	switch ((BrickCoord.X + BrickCoord.Y + BrickCoord.Z) % 6)
+	{
+	case 0: BrickColor = FColor::Red; break;
+	case 1: BrickColor = FColor::Green; break;
+	case 2: BrickColor = FColor::Blue; break;
+	case 3: BrickColor = FColor::Yellow; break;
+	case 4: BrickColor = FColor::Cyan; break;
+	case 5: BrickColor = FColor::Magenta; break;
+	default: BrickColor = FColor::White;
 	}
 	
-	// 绘制节点边界框
-	FVector Center = Node.Bounds.Center();
-	FVector Extent = Node.Bounds.Extents();
+	// 绘制砖块边界框（砖块在目标局部空间，换算到世界空间）
+	FAxisAlignedBox3d BrickBounds = VoxelData.GetBrickBounds(BrickCoord);
+	FTransform TargetToWorld = TargetMeshComponent ? TargetMeshComponent->GetComponentTransform() : FTransform::Identity;
+	FVector Center = TargetToWorld.TransformPosition(BrickBounds.Center());
+	FVector Extent = BrickBounds.Extents() * TargetToWorld.GetScale3D();
 	
 	// 使用DrawDebugBox绘制边界框
-	DrawDebugBox(GetWorld(), Center, Extent, NodeColor, true, -1.0f, 0, 2.0f);
+	DrawDebugBox(GetWorld(), Center, Extent, TargetToWorld.GetRotation(), BrickColor, true, -1.0f, 0, 2.0f);
 	
 	// 存储调试信息以便后续管理
 	FDebugBoxInfo BoxInfo;
 	BoxInfo.Center = Center;
 	BoxInfo.Extent = Extent;
-	BoxInfo.Color = NodeColor;
+	BoxInfo.Color = BrickColor;
 	DebugBoxes.Add(BoxInfo);
 	
-	// 如果是叶子节点，绘制额外的信息
-	if (Node.bIsLeaf)
-	{
-		// 绘制小球标记叶子节点
-		DrawDebugSphere(GetWorld(), Center, 5.0f, 8, FColor::White, true, -1.0f, 0, 1.0f);
-		
-		// 显示体素数量信息
-		if (Node.Voxels.Num() > 0)
-		{
-			FString VoxelInfo = FString::Printf(TEXT("Leaf L%d\nVoxels:%d"), Depth, Node.Voxels.Num());
-			DrawDebugString(GetWorld(), Center + FVector(0,0,20), VoxelInfo, nullptr, FColor::White, -1.0f, true);
-		}
-	}
-	else
-	{
-		// 非叶子节点显示深度信息
-		FString DepthInfo = FString::Printf(TEXT("Node L%d\nChildren:%d"), Depth, Node.Children.Num());
-		DrawDebugString(GetWorld(), Center + FVector(0,0,20), DepthInfo, nullptr, NodeColor, -1.0f, true);
-	}
-	
-	// 递归处理子节点
-	for (const FOctreeNode& Child : Node.Children)
-	{
-		VisualizeOctreeNodeRecursive(Child, Depth + 1);
-	}
+	// 显示砖块坐标信息
+	FString BrickInfo = FString::Printf(TEXT("Brick %s\nVoxels:%d"), *BrickCoord.ToString(), FMaVoxelData::BrickVoxelCount);
+	DrawDebugString(GetWorld(), Center + FVector(0,0,20), BrickInfo, nullptr, FColor::White, -1.0f, true);
 }
 
 void UVoxelCutComponent::ClearOctreeVisualization()
@@ -336,82 +701,52 @@ void UVoxelCutComponent::ClearOctreeVisualization()
 
 void UVoxelCutComponent::PrintOctreeDetails()
 {
-    if (!CutOp || !CutOp->PersistentVoxelData.IsValid())
+    if (!bSystemInitialized || !CutOp || !CutOp->PersistentVoxelData.IsValid())
     {
         UE_LOG(LogTemp, Warning, TEXT("无法打印八叉树详情：体素数据未初始化"));
         return;
     }
-    
-    UE_LOG(LogTemp, Warning, TEXT("========== 八叉树详细信息 =========="));
-    
-    int32 TotalNodes = 0;
-    int32 TotalLeaves = 0;
-    int32 TotalVoxels = 0;
-    
-    // 递归打印
-    PrintOctreeNodeRecursive(CutOp->PersistentVoxelData->OctreeRoot, 0, TotalNodes, TotalLeaves, TotalVoxels);
-    
-    UE_LOG(LogTemp, Warning, TEXT("八叉树统计摘要:"));
-    UE_LOG(LogTemp, Warning, TEXT("  总节点数: %d"), TotalNodes);
-    UE_LOG(LogTemp, Warning, TEXT("  叶子节点数: %d"), TotalLeaves);
-    UE_LOG(LogTemp, Warning, TEXT("  非叶子节点数: %d"), TotalNodes - TotalLeaves);
-    UE_LOG(LogTemp, Warning, TEXT("  存储的体素数: %d"), TotalVoxels);
-    UE_LOG(LogTemp, Warning, TEXT("  根节点边界: Min(%s), Max(%s)"), 
-           *CutOp->PersistentVoxelData->OctreeRoot.Bounds.Min.ToString(), 
-           *CutOp->PersistentVoxelData->OctreeRoot.Bounds.Max.ToString());
-    UE_LOG(LogTemp, Warning, TEXT("  根节点尺寸: %s"), 
-           *(CutOp->PersistentVoxelData->OctreeRoot.Bounds.Max-CutOp->PersistentVoxelData->OctreeRoot.Bounds.Min).ToString());
-    UE_LOG(LogTemp, Warning, TEXT("========== 结束八叉树信息 =========="));
-}
 
-void UVoxelCutComponent::PrintOctreeNodeRecursive(const FOctreeNode& Node, int32 Depth, int32& NodeCount, int32& LeafCount, int32& TotalVoxels)
-{
-    NodeCount++;
+    const FMaVoxelData& VoxelData = *CutOp->PersistentVoxelData;
     
-    // 创建缩进字符串以便于阅读层级关系
-    FString Indent;
-    for (int32 i = 0; i < Depth; i++)
-    {
-        Indent += "  ";
-    }
+    UE_LOG(LogTemp, Warning, TEXT("========== 砖块网格详细信息 =========="));
     
-    FString NodeType = Node.bIsLeaf ? TEXT("叶子") : TEXT("分支");
-    FString EmptyStatus = Node.bIsEmpty ? TEXT("空") : TEXT("非空");
-    
-    UE_LOG(LogTemp, Warning, TEXT("%sL%d-%s-%s: 边界[%s -> %s], 尺寸(%s)"), 
-           *Indent, Depth, *NodeType, *EmptyStatus,
-           *Node.Bounds.Min.ToString(), 
-           *Node.Bounds.Max.ToString(),
-           *(Node.Bounds.Max-Node.Bounds.Min).ToString());
-    
-    if (Node.bIsLeaf)
+    // 逐个打印已分配的砖块
+    for (int32 PoolIndex = 0; PoolIndex < VoxelData.BrickCoords.Num(); PoolIndex++)
     {
-        LeafCount++;
-        TotalVoxels += Node.Voxels.Num();
+        if (!VoxelData.IsPoolSlotInUse(PoolIndex)) continue;
+
+        const FIntVector& BrickCoord = VoxelData.BrickCoords[PoolIndex];
+        FAxisAlignedBox3d BrickBounds = VoxelData.GetBrickBounds(BrickCoord);
+        
+        UE_LOG(LogTemp, Warning, TEXT("砖块%s-槽位%d: 边界[%s -> %s]"), 
+               *BrickCoord.ToString(), PoolIndex,
+               *BrickBounds.Min.ToString(), 
+               *BrickBounds.Max.ToString());
         
-        if (!Node.bIsEmpty && Node.Voxels.Num() > 0)
+        // 打印前几个体素的值作为样本
+        FString SampleValues;
+        for (int32 i = 0; i < 5; i++)
         {
-            UE_LOG(LogTemp, Warning, TEXT("%s  体素配置: %d个体素"), 
-                   *Indent, Node.Voxels.Num());
-            
-            // 打印前几个体素的值作为样本
-            int32 SampleCount = FMath::Min(5, Node.Voxels.Num());
-            FString SampleValues;
-            for (int32 i = 0; i < SampleCount; i++)
-            {
-                SampleValues += FString::Printf(TEXT("%.2f "), Node.Voxels[i]);
-            }
-            UE_LOG(LogTemp, Warning, TEXT("%s  体素值样本: %s"), *Indent, *SampleValues);
+            SampleValues += FString::Printf(TEXT("%.2f "), VoxelData.GetBrickValue(PoolIndex, i));
         }
-    }
-    else
-    {
-        UE_LOG(LogTemp, Warning, TEXT("%s  子节点数: %d"), *Indent, Node.Children.Num());
+        UE_LOG(LogTemp, Warning, TEXT("  体素值样本: %s"), *SampleValues);
     }
     
-    // 递归处理子节点
-    for (const FOctreeNode& Child : Node.Children)
-    {
-        PrintOctreeNodeRecursive(Child, Depth + 1, NodeCount, LeafCount, TotalVoxels);
-    }
-}
\ No newline at end of file
+    int32 TotalBricks = VoxelData.BrickTable.Num();
+    int32 AllocatedBricks = VoxelData.GetNumAllocatedBricks();
+    
+    UE_LOG(LogTemp, Warning, TEXT("砖块网格统计摘要:"));
+    UE_LOG(LogTemp, Warning, TEXT("  网格尺寸: %s"), *VoxelData.BrickDims.ToString());
+    UE_LOG(LogTemp, Warning, TEXT("  总砖块数: %d"), TotalBricks);
+    UE_LOG(LogTemp, Warning, TEXT("  已分配砖块数: %d"), AllocatedBricks);
+    UE_LOG(LogTemp, Warning, TEXT("  均匀砖块数: %d"), TotalBricks - AllocatedBricks);
+    UE_LOG(LogTemp, Warning, TEXT("  存储的体素数: %lld"), (int64)AllocatedBricks * FMaVoxelData::BrickVoxelCount);
+    UE_LOG(LogTemp, Warning, TEXT("  体素间距: %.3f"), VoxelData.VoxelSize);
+    UE_LOG(LogTemp, Warning, TEXT("  根节点边界: Min(%s), Max(%s)"), 
+           *VoxelData.Bounds.Min.ToString(), 
+           *VoxelData.Bounds.Max.ToString());
+    UE_LOG(LogTemp, Warning, TEXT("  根节点尺寸: %s"), 
+           *(VoxelData.Bounds.Max - VoxelData.Bounds.Min).ToString());
+    UE_LOG(LogTemp, Warning, TEXT("========== 结束砖块网格信息 =========="));
+}
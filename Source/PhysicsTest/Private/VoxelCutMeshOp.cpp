@@ -7,14 +7,13 @@
 #include "DynamicMesh/MeshTransforms.h"
 #include "DynamicMesh/MeshNormals.h"
 #include "Operations/MeshBoolean.h"
-#include "Generators/MarchingCubes.h"
 #include "DynamicMesh/DynamicMesh3.h"
 #include "HAL/PlatformTime.h"
+#include "VoxelDataCache.h"
+#include "VoxelKernels.h"
 
 using namespace UE::Geometry;
 
-UE_DISABLE_OPTIMIZATION
-
 void FVoxelCutMeshOp::SetTransform(const FTransformSRT3d& Transform)
 {
     ResultTransform = Transform;
@@ -63,38 +62,106 @@ bool FVoxelCutMeshOp::InitializeVoxelData(FProgressCancel* Progress)
         return false;
     }
     
-    // 创建新的体素数据容器
+    // 创建新的体素数据容器。体素网格建立在目标局部空间，精度参数按目标缩放换算，保持世界空间的精度不变
+    double TargetScale = FMath::Max(TargetTransform.GetScale3D().GetAbsMax(), UE_KINDA_SMALL_NUMBER);
     if (!PersistentVoxelData.IsValid())
     {
         PersistentVoxelData = MakeShared<FMaVoxelData>();
-        PersistentVoxelData->MarchingCubeSize = MarchingCubeSize;
+        PersistentVoxelData->MarchingCubeSize = MarchingCubeSize / TargetScale;
         PersistentVoxelData->MaxOctreeDepth = MaxOctreeDepth;
-        PersistentVoxelData->MinVoxelSize = MinVoxelSize;        
+        PersistentVoxelData->MinVoxelSize = MinVoxelSize / TargetScale;
+        PersistentVoxelData->StorageFormat = VoxelStorageFormat;
     }
 
-    // 体素化目标网格
-    bool success = VoxelizeMesh(*TargetMesh, TargetTransform,*PersistentVoxelData, Progress); 
+    // 体素化目标网格（占初始化进度的大部分，剩余部分留给刀具距离场）
+    // 相同输入的体素化结果直接从磁盘缓存读取
+    FProgressCancel::FProgressScope VoxelizeScope(Progress, 0.9f);
+    FString CacheKey;
+    bool success = false;
+    if (bUseVoxelCache)
+    {
+        CacheKey = FVoxelDataCache::ComputeKey(*TargetMesh, *PersistentVoxelData, VoxelizeMethod);
+        success = FVoxelDataCache::Load(CacheKey, *PersistentVoxelData);
+    }
+    if (!success)
+    {
+        success = VoxelizeMesh(*TargetMesh, FTransform::Identity, *PersistentVoxelData, Progress);
+        if (success && bUseVoxelCache)
+        {
+            FVoxelDataCache::Save(CacheKey, *PersistentVoxelData);
+        }
+    }
+    VoxelizeScope.Done();
 
-    bVoxelDataInitialized = true;    
+    // 按需细化：构建结果作为只读父级，未加工的区域保持构建精度，切削到的砖块在第一次被修改时才细化
+    if (success && CutVoxelSize > 0.0)
+    {
+        const double LocalCutVoxelSize = CutVoxelSize / TargetScale;
+        int32 Factor = 1;
+        while (Factor < FMaVoxelData::MaxRefineFactor && PersistentVoxelData->VoxelSize / Factor > LocalCutVoxelSize + UE_KINDA_SMALL_NUMBER)
+        {
+            Factor *= 2;
+        }
+        if (Factor > 1)
+        {
+            TSharedPtr<FMaVoxelData, ESPMode::ThreadSafe> BuildData = MakeShared<FMaVoxelData, ESPMode::ThreadSafe>(MoveTemp(*PersistentVoxelData));
+            PersistentVoxelData->InitializeRefined(BuildData, Factor);
+            UE_LOG(LogTemp, Log, TEXT("按需细化: 构建体素间距=%.3f, 切削体素间距=%.3f (x%d)"), BuildData->VoxelSize, PersistentVoxelData->VoxelSize, Factor);
+        }
+
+        // 提取网格的单元同样缩小到切削精度，细化的砖块才会体现在表面上
+        // （否则提取器按 MarchingCubeSize 隔点取格点，细化的体素全部被跳过）；未加工区域从父级插值，形状不变，只是三角形更密
+        PersistentVoxelData->MarchingCubeSize = FMath::Min(PersistentVoxelData->MarchingCubeSize, LocalCutVoxelSize);
+    }
+
+    // 体素数据重建后，网格分块缓存全部失效
+    bMeshChunksValid = false;
+    DirtyBounds = FAxisAlignedBox3d::Empty();
+
+    bVoxelDataInitialized = success;    
     return success;
 }
 
+bool FVoxelCutMeshOp::InitializeToolSDF(FProgressCancel* Progress)
+{
+    // 参数化刀具有闭式距离，不需要烘焙
+    if (ToolShape.IsAnalytic())
+    {
+        return true;
+    }
+
+    if (!CutToolMesh || !PersistentVoxelData.IsValid() || !PersistentVoxelData->IsValid())
+    {
+        return false;
+    }
+
+    // 采样间距与目标体素一致，并覆盖切削时的更新边界扩展
+    TSharedPtr<FVoxelToolSDF, ESPMode::ThreadSafe> NewToolSDF = MakeShared<FVoxelToolSDF, ESPMode::ThreadSafe>();
+    double Padding = (UpdateMargin + 1) * PersistentVoxelData->MarchingCubeSize;
+    if (!NewToolSDF->Build(*CutToolMesh, PersistentVoxelData->VoxelSize, Padding, Progress))
+    {
+        return false;
+    }
+
+    ToolSDF = NewToolSDF;
+    return true;
+}
+
 bool FVoxelCutMeshOp::IncrementalCut(FProgressCancel* Progress)
 {
-    if (!PersistentVoxelData.IsValid() || !CutToolMesh)
+    if (!PersistentVoxelData.IsValid() || (!CutToolMesh && !ToolShape.IsAnalytic()))
     {
         return false;
     }
 
     // 局部更新：只更新受刀具影响的区域
-    UpdateLocalRegion(*PersistentVoxelData, *CutToolMesh, 
-                     CutToolTransform, Progress);
+    UpdateLocalRegion(*PersistentVoxelData, CutToolMesh.Get(), Progress);
     
 
     return !(Progress && Progress->Cancelled());
 }
 
-double GetDistanceToMesh(const FDynamicMeshAABBTree3& Spatial, TFastWindingTree<FDynamicMesh3> Winding, const FVector3d& LocalPoint, const FVector3d& WorldPoint)
+double GetDistanceToMesh(const FDynamicMeshAABBTree3& Spatial, const TFastWindingTree<FDynamicMesh3>& Winding, const FVector3d& LocalPoint, const FVector3d& WorldPoint)
 {
     double NearestDistSqr; 
     int NearestTriID = Spatial.FindNearestTriangle(LocalPoint, NearestDistSqr);
@@ -129,8 +196,21 @@ bool FVoxelCutMeshOp::VoxelizeMesh(const FDynamicMesh3& Mesh, const FTransform&
     }
     double StartTime = FPlatformTime::Seconds();
     
-    // 从模型构建八叉树
-    VoxelData.BuildOctreeFromMesh(Mesh, Transform);
+    // 从模型构建体素数据
+    bool bBuilt = false;
+    switch (VoxelizeMethod)
+    {
+    case EVoxelizeMethod::Rasterize:
+        bBuilt = VoxelData.BuildFromMeshRasterized(Mesh, Transform, Progress);
+        break;
+    default:
+        bBuilt = VoxelData.BuildOctreeFromMesh(Mesh, Transform, Progress);
+        break;
+    }
+    if (!bBuilt)
+    {
+        return false;
+    }
     
     double EndTime = FPlatformTime::Seconds();
     UE_LOG(LogTemp, Warning, TEXT("网格体素化耗时: %.2f 毫秒"), (EndTime - StartTime) * 1000.0);
@@ -140,8 +220,79 @@ bool FVoxelCutMeshOp::VoxelizeMesh(const FDynamicMesh3& Mesh, const FTransform&
 
 
 
-void FVoxelCutMeshOp::UpdateLocalRegion(FMaVoxelData& TargetVoxels, const FDynamicMesh3& ToolMesh, 
-                                       const FTransform& ToolTransform, FProgressCancel* Progress)
+namespace
+{
+    // 扫掠路径上的一个刀具位姿
+    struct FSweepPose
+    {
+        FTransform Transform;
+        FAxisAlignedBox3d UpdateBounds;   // 该位姿下刀具的世界边界（含更新扩展）
+        double DistanceScale;             // 局部距离换算到世界距离的比例
+    };
+    
+    // 沿扫掠路径切削：每个体素取所有覆盖它的位姿中刀具距离的最小值，即扫掠体的距离，
+    // 再与目标距离做布尔运算。不在任何位姿范围内的体素到刀具的距离至少为 OutsideDistance
+    template<typename LocalDistanceFuncType>
+    int64 CutAlongSweep(FMaVoxelData& TargetVoxels, const TArray<FSweepPose>& Poses, const FAxisAlignedBox3d& UpdateBounds,
+                        EVoxelCSGOperation Operation, double Smoothness, double OutsideDistance, LocalDistanceFuncType&& LocalDistance)
+    {
+        // 堆积会在空区域生成材料，空的均匀砖块也要参与更新
+        bool bAddsMaterial = Operation == EVoxelCSGOperation::Union || Operation == EVoxelCSGOperation::SmoothUnion;
+        return TargetVoxels.UpdateRegion(UpdateBounds,
+            [&](TArrayView<const FVector3d> Positions, TArrayView<float> Values)
+            {
+                // 会在多个线程中同时调用，只能读取共享数据；被修改的体素数由 UpdateRegion 统计
+                // 先逐点求刀具距离，再对整个砖块做布尔运算
+                alignas(16) float ToolDistances[FMaVoxelData::BrickVoxelCount];
+                for (int32 i = 0; i < Positions.Num(); i++)
+                {
+                    double ToolDistance = TNumericLimits<double>::Max();
+                    for (const FSweepPose& Pose : Poses)
+                    {
+                        if (!Pose.UpdateBounds.Contains(Positions[i])) continue;
+
+                        FVector3d LocalPos = Pose.Transform.InverseTransformPosition(Positions[i]);
+                        ToolDistance = FMath::Min(ToolDistance, LocalDistance(LocalPos) * Pose.DistanceScale);
+                    }
+                    ToolDistances[i] = (ToolDistance == TNumericLimits<double>::Max()) ? VoxelKernels::ToolNotCovered : (float)ToolDistance;
+                }
+
+                VoxelKernels::ApplyCSG(Values.GetData(), ToolDistances, Values.Num(), Operation, (float)Smoothness, (float)OutsideDistance);
+            }, bAddsMaterial);
+    }
+}
+
+void FVoxelCutMeshOp::BuildSweepPoses(const FAxisAlignedBox3d& LocalToolBounds, double StepSize, TArray<FTransform>& OutPoses) const
+{
+    TArray<FTransform> KeyPoses = SweepWaypoints;
+    KeyPoses.Add(CutToolTransform);
+
+    // 刀具上离原点最远的点，用于把旋转换算成位移
+    double ToolRadius = FMath::Max(LocalToolBounds.Min.Length(), LocalToolBounds.Max.Length())
+        * CutToolTransform.GetScale3D().GetAbsMax();
+
+    OutPoses.Reset();
+    OutPoses.Add(KeyPoses[0]);
+    for (int32 k = 1; k < KeyPoses.Num(); k++)
+    {
+        const FTransform& From = KeyPoses[k - 1];
+        const FTransform& To = KeyPoses[k];
+
+        // 相邻插值位姿之间刀具表面的最大位移不超过步长
+        double Travel = FVector3d::Distance(From.GetLocation(), To.GetLocation())
+            + From.GetRotation().AngularDistance(To.GetRotation()) * ToolRadius;
+        int32 Steps = FMath::Clamp(FMath::CeilToInt32(Travel / StepSize), 1, FMath::Max(1, MaxSweepSteps));
+
+        for (int32 Step = 1; Step <= Steps; Step++)
+        {
+            FTransform Pose;
+            Pose.Blend(From, To, (float)Step / Steps);
+            OutPoses.Add(Pose);
+        }
+    }
+}
+
+void FVoxelCutMeshOp::UpdateLocalRegion(FMaVoxelData& TargetVoxels, const FDynamicMesh3* ToolMesh, FProgressCancel* Progress)
 {
     if (!TargetVoxels.IsValid()) 
     {
@@ -150,97 +301,692 @@ void FVoxelCutMeshOp::UpdateLocalRegion(FMaVoxelData& TargetVoxels, const FDynam
     }
 
     double StartTime = FPlatformTime::Seconds();
-    
-    // 使用八叉树优化更新
-    FDynamicMesh3 TransformedToolMesh = ToolMesh;
-    MeshTransforms::ApplyTransform(TransformedToolMesh, ToolTransform, true);
-    
-    FDynamicMeshAABBTree3 ToolSpatial(&TransformedToolMesh);    
-    TFastWindingTree<FDynamicMesh3> ToolWinding(&ToolSpatial);
 
-    FAxisAlignedBox3d TargetBounds = TargetVoxels.GetOctreeBounds();
-    
-    // 计算刀具的边界框（扩展更新边界）
-    FAxisAlignedBox3d ToolBounds = TransformedToolMesh.GetBounds();
-
-    // UE_LOG(LogTemp, Warning, TEXT("目标体边界: Min=%s, Max=%s"), 
-    //            *TargetBounds.Min.ToString(), *TargetBounds.Max.ToString());
-    // UE_LOG(LogTemp, Warning, TEXT("刀具边界: Min=%s, Max=%s"), 
-    //        *ToolBounds.Min.ToString(), *ToolBounds.Max.ToString());
-    // UE_LOG(LogTemp, Warning, TEXT("两者是否相交: %s"), 
-    //        TargetBounds.Intersects(ToolBounds) ? TEXT("是") : TEXT("否"));
-    
-    FVector3d ExpandedMin = ToolBounds.Min - FVector3d(UpdateMargin * TargetVoxels.MarchingCubeSize);
-    FVector3d ExpandedMax = ToolBounds.Max + FVector3d(UpdateMargin * TargetVoxels.MarchingCubeSize);
-    FAxisAlignedBox3d UpdateBounds(ExpandedMin, ExpandedMax);
+    // 刀具在局部空间中的边界
+    bool bUseToolSDF = !ToolShape.IsAnalytic() && ToolSDF.IsValid() && ToolSDF->IsValid();
+    FAxisAlignedBox3d LocalToolBounds = ToolShape.IsAnalytic() ? ToolShape.GetLocalBounds()
+        : bUseToolSDF ? ToolSDF->MeshBounds
+        : ToolMesh ? ToolMesh->GetBounds() : FAxisAlignedBox3d::Empty();
+    if (LocalToolBounds.IsEmpty())
+    {
+        return;
+    }
 
-    int32 UpdatedVoxels = 0;
-    
-    // 使用八叉树局部更新
-    TargetVoxels.UpdateRegion(UpdateBounds, 
-        [&](const FVector3d& WorldPos) -> float
+    // 体素位于目标局部空间，世界单位的参数按目标缩放换算
+    double TargetScale = FMath::Max(TargetTransform.GetScale3D().GetAbsMax(), UE_KINDA_SMALL_NUMBER);
+
+    // 沿扫掠路径插值位姿，并计算每个位姿的更新边界
+    double StepSize = SweepStepSize > 0.0 ? SweepStepSize / TargetScale : TargetVoxels.VoxelSize;
+    TArray<FTransform> PoseTransforms;
+    BuildSweepPoses(LocalToolBounds, StepSize, PoseTransforms);
+
+    // 平滑运算的影响范围比刀具大出过渡宽度
+    bool bSmooth = CutOperation == EVoxelCSGOperation::SmoothSubtract || CutOperation == EVoxelCSGOperation::SmoothUnion;
+    double Smoothness = bSmooth ? FMath::Max(CSGSmoothness, 0.0) / TargetScale : 0.0;
+    double Margin = UpdateMargin * TargetVoxels.MarchingCubeSize + Smoothness;
+    TArray<FSweepPose> Poses;
+    FAxisAlignedBox3d UpdateBounds = FAxisAlignedBox3d::Empty();
+    for (const FTransform& PoseTransform : PoseTransforms)
+    {
+        FAxisAlignedBox3d ToolBounds(LocalToolBounds, PoseTransform);
+        FAxisAlignedBox3d PoseBounds(ToolBounds.Min - FVector3d(Margin), ToolBounds.Max + FVector3d(Margin));
+        // 距离场与参数化刀具都定义在未缩放的局部空间，按缩放换算回世界距离
+        Poses.Add(FSweepPose{PoseTransform, PoseBounds, PoseTransform.GetScale3D().GetAbsMin()});
+        UpdateBounds.Contain(PoseBounds);
+    }
+
+    // 求交会清除刀具外的全部材料：与扫掠范围相交的砖块扩展到整个砖块后逐体素更新，
+    // 其余砖块直接在索引表中置空，只有原先含有材料的砖块需要重新提取网格
+    if (CutOperation == EVoxelCSGOperation::Intersect)
+    {
+        FIntVector KeepMin, KeepMax;
+        TargetVoxels.GetBrickRange(UpdateBounds, KeepMin, KeepMax);
+        if (UpdateBounds.IsEmpty() || KeepMin.X > KeepMax.X || KeepMin.Y > KeepMax.Y || KeepMin.Z > KeepMax.Z)
         {
-            FVector3d LocalPos = ToolTransform.InverseTransformPosition(WorldPos);
-            double ToolDistance = GetDistanceToMesh(ToolSpatial, ToolWinding, LocalPos, WorldPos);
-            
-            float CurrentValue = TargetVoxels.GetValueAtPosition(WorldPos);
-            
-            // 切削逻辑：如果工具在内部，设为正值（外部）
-            if (ToolDistance < 0 && CurrentValue < 0)
-            {
-                UpdatedVoxels++;
-                return FMath::Abs(CurrentValue); // 切削掉内部区域
-            }
-            
-            return CurrentValue; // 保持原值
-        });
+            KeepMin = FIntVector(0, 0, 0);
+            KeepMax = FIntVector(-1, -1, -1);
+            UpdateBounds = FAxisAlignedBox3d::Empty();
+        }
+        else
+        {
+            UpdateBounds = FAxisAlignedBox3d(TargetVoxels.GetBrickBounds(KeepMin).Min, TargetVoxels.GetBrickBounds(KeepMax).Max);
+            UpdateBounds.Expand(0.5 * TargetVoxels.VoxelSize);
+        }
+        DirtyBounds.Contain(TargetVoxels.ClearBricksOutside(KeepMin, KeepMax, (float)Margin));
+    }
+
+    // 扫掠体的范围同时也是网格需要重新提取的范围
+    DirtyBounds.Contain(UpdateBounds);
+
+    int64 UpdatedVoxels = 0;
+    if (ToolShape.IsAnalytic())
+    {
+        // 参数化刀具：闭式距离
+        const FVoxelToolShape& Shape = ToolShape;
+        UpdatedVoxels = CutAlongSweep(TargetVoxels, Poses, UpdateBounds, CutOperation, Smoothness, Margin,
+            [&Shape](const FVector3d& LocalPos) { return Shape.Evaluate(LocalPos); });
+    }
+    else if (bUseToolSDF)
+    {
+        // 预烘焙的刀具距离场：逆变换到刀具局部空间后三线性插值
+        const FVoxelToolSDF& ToolField = *ToolSDF;
+        UpdatedVoxels = CutAlongSweep(TargetVoxels, Poses, UpdateBounds, CutOperation, Smoothness, Margin,
+            [&ToolField](const FVector3d& LocalPos) { return (double)ToolField.Sample(LocalPos); });
+    }
+    else
+    {
+        // 未烘焙距离场时直接在局部空间查询刀具网格
+        FDynamicMeshAABBTree3 ToolSpatial(ToolMesh);
+        TFastWindingTree<FDynamicMesh3> ToolWinding(&ToolSpatial);
+        UpdatedVoxels = CutAlongSweep(TargetVoxels, Poses, UpdateBounds, CutOperation, Smoothness, Margin,
+            [&ToolSpatial, &ToolWinding](const FVector3d& LocalPos) { return GetDistanceToMesh(ToolSpatial, ToolWinding, LocalPos, LocalPos); });
+    }
     
     double EndTime = FPlatformTime::Seconds();
-    UE_LOG(LogTemp, Warning, TEXT("局部区域更新耗时: %.2f 毫秒, 更新了 %d 个体素"), (EndTime - StartTime) * 1000.0, UpdatedVoxels);
+    UE_LOG(LogTemp, Warning, TEXT("局部区域更新耗时: %.2f 毫秒, 扫掠位姿 %d 个, 更新了 %lld 个体素"),
+        (EndTime - StartTime) * 1000.0, Poses.Num(), UpdatedVoxels);
     
     // 切削后对局部区域进行高斯平滑（减少体素值突变）
     //SmoothLocalVoxels(TargetVoxels, VoxelMin, VoxelMax, 1);
 }
 
 
+void FVoxelCutMeshOp::BenchmarkToolDistance(int32 NumSamples) const
+{
+    if (!CutToolMesh || NumSamples <= 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("BenchmarkToolDistance: 需要刀具网格"));
+        return;
+    }
+
+    // 在刀具边界（外扩一点）内随机取样
+    FAxisAlignedBox3d SampleBounds = CutToolMesh->GetBounds();
+    SampleBounds.Expand(0.25 * SampleBounds.MaxDim());
+    FRandomStream Random(12345);
+    TArray<FVector3d> Samples;
+    Samples.SetNumUninitialized(NumSamples);
+    for (FVector3d& Sample : Samples)
+    {
+        Sample = FVector3d(
+            Random.FRandRange(SampleBounds.Min.X, SampleBounds.Max.X),
+            Random.FRandRange(SampleBounds.Min.Y, SampleBounds.Max.Y),
+            Random.FRandRange(SampleBounds.Min.Z, SampleBounds.Max.Z));
+    }
+
+    TArray<double> MeshDistances, Distances;
+    MeshDistances.SetNumUninitialized(NumSamples);
+    Distances.SetNumUninitialized(NumSamples);
+
+    // 网格查询（基准）
+    double StartTime = FPlatformTime::Seconds();
+    FDynamicMeshAABBTree3 Spatial(CutToolMesh.Get());
+    TFastWindingTree<FDynamicMesh3> Winding(&Spatial);
+    for (int32 i = 0; i < NumSamples; i++)
+    {
+        MeshDistances[i] = GetDistanceToMesh(Spatial, Winding, Samples[i], Samples[i]);
+    }
+    double MeshTime = FPlatformTime::Seconds() - StartTime;
+    UE_LOG(LogTemp, Warning, TEXT("刀具距离测试[网格]: %d 个采样, %.2f 毫秒"), NumSamples, MeshTime * 1000.0);
+
+    auto Report = [&](const TCHAR* Name, double ElapsedSeconds)
+    {
+        double MaxError = 0.0;
+        int32 SignMismatches = 0;
+        for (int32 i = 0; i < NumSamples; i++)
+        {
+            MaxError = FMath::Max(MaxError, FMath::Abs(Distances[i] - MeshDistances[i]));
+            SignMismatches += ((Distances[i] < 0) != (MeshDistances[i] < 0)) ? 1 : 0;
+        }
+        UE_LOG(LogTemp, Warning, TEXT("刀具距离测试[%s]: %.2f 毫秒 (加速 %.1fx), 最大误差 %.4f, 符号不一致 %d"),
+            Name, ElapsedSeconds * 1000.0, MeshTime / FMath::Max(ElapsedSeconds, 1e-9), MaxError, SignMismatches);
+    };
+
+    if (ToolSDF.IsValid() && ToolSDF->IsValid())
+    {
+        StartTime = FPlatformTime::Seconds();
+        for (int32 i = 0; i < NumSamples; i++)
+        {
+            Distances[i] = ToolSDF->Sample(Samples[i]);
+        }
+        Report(TEXT("距离场"), FPlatformTime::Seconds() - StartTime);
+    }
+
+    if (ToolShape.IsAnalytic())
+    {
+        StartTime = FPlatformTime::Seconds();
+        for (int32 i = 0; i < NumSamples; i++)
+        {
+            Distances[i] = ToolShape.Evaluate(Samples[i]);
+        }
+        Report(*UEnum::GetDisplayValueAsText(ToolShape.Type).ToString(), FPlatformTime::Seconds() - StartTime);
+    }
+}
+
+void FVoxelCutMeshOp::BenchmarkVoxelSampling(int32 NumSamples) const
+{
+    if (!PersistentVoxelData.IsValid() || !PersistentVoxelData->IsValid() || NumSamples <= 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("BenchmarkVoxelSampling: 需要体素数据"));
+        return;
+    }
+    const FMaVoxelData& Voxels = *PersistentVoxelData;
+
+    // 沿随机游走取样，模拟空间上连续的查询
+    FRandomStream Random(12345);
+    TArray<FVector3d> Samples;
+    Samples.SetNumUninitialized(NumSamples);
+    FVector3d Pos = Voxels.Bounds.Center();
+    for (FVector3d& Sample : Samples)
+    {
+        Pos += FVector3d(Random.VRand()) * (0.5 * Voxels.VoxelSize);
+        Pos = FVector3d(
+            FMath::Clamp(Pos.X, Voxels.Bounds.Min.X, Voxels.Bounds.Max.X),
+            FMath::Clamp(Pos.Y, Voxels.Bounds.Min.Y, Voxels.Bounds.Max.Y),
+            FMath::Clamp(Pos.Z, Voxels.Bounds.Min.Z, Voxels.Bounds.Max.Z));
+        Sample = Pos;
+    }
+
+    TArray<float> Reference, Values;
+    Reference.SetNumUninitialized(NumSamples);
+    Values.SetNumUninitialized(NumSamples);
+
+    double StartTime = FPlatformTime::Seconds();
+    for (int32 i = 0; i < NumSamples; i++)
+    {
+        Reference[i] = Voxels.GetValueAtPosition(Samples[i]);
+    }
+    double ScalarTime = FPlatformTime::Seconds() - StartTime;
+    UE_LOG(LogTemp, Warning, TEXT("体素采样测试[逐点]: %d 个采样, %.2f 毫秒"), NumSamples, ScalarTime * 1000.0);
+
+    auto Report = [&](const TCHAR* Name, double ElapsedSeconds)
+    {
+        float MaxError = 0.0f;
+        for (int32 i = 0; i < NumSamples; i++)
+        {
+            MaxError = FMath::Max(MaxError, FMath::Abs(Values[i] - Reference[i]));
+        }
+        UE_LOG(LogTemp, Warning, TEXT("体素采样测试[%s]: %.2f 毫秒 (加速 %.1fx), 最大误差 %.6f"),
+            Name, ElapsedSeconds * 1000.0, ScalarTime / FMath::Max(ElapsedSeconds, 1e-9), MaxError);
+    };
+
+    StartTime = FPlatformTime::Seconds();
+    FMaVoxelAccessor Accessor(Voxels);
+    Accessor.GetValuesAtPositions(Samples, Values);
+    Report(TEXT("读取器"), FPlatformTime::Seconds() - StartTime);
+
+    StartTime = FPlatformTime::Seconds();
+    Voxels.GetValuesAtPositions(Samples, Values);
+    Report(TEXT("批量"), FPlatformTime::Seconds() - StartTime);
+}
+
 void FVoxelCutMeshOp::ConvertVoxelsToMesh(const FMaVoxelData& Voxels, FProgressCancel* Progress)
 {
     if (Progress && Progress->Cancelled()) return;
     
-    double StartTime = FPlatformTime::Seconds();
+    // 确定需要重新提取的分块
+    TArray<FIntVector> DirtyChunks;
+    bool bRebuildAll = false;
+    CollectDirtyChunks(Voxels, DirtyChunks, bRebuildAll);
+
+    GenerateMeshFromChunks(Voxels, DirtyChunks, bRebuildAll, Progress);
+}
+
+bool FVoxelCutMeshOp::UpdateVoxelsStage(FVoxelMeshSnapshot& OutSnapshot, FProgressCancel* Progress)
+{
+    if (!bVoxelDataInitialized)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Initialize Voxel Data First! (Call InitializeVoxelData())"));
+        return false;
+    }
+
+    if (!IncrementalCut(Progress))
+    {
+        return false;
+    }
+
+    // 切削区域内已经整体远离表面的砖块收回，内存随剩余表面而不是原始零件变化
+    if (bCollapseUniformBricks && !DirtyBounds.IsEmpty())
+    {
+        double CollapseStart = FPlatformTime::Seconds();
+        int32 NumCollapsed = PersistentVoxelData->CollapseUniformBricks(DirtyBounds, CollapseBandVoxels);
+        int32 NumMoved = PersistentVoxelData->CompactPool();
+        if (NumCollapsed > 0)
+        {
+            UE_LOG(LogTemp, Log, TEXT("砖块回收耗时: %.2f 毫秒, 收回砖块=%d, 整理移动=%d, 剩余砖块=%d"),
+                (FPlatformTime::Seconds() - CollapseStart) * 1000.0, NumCollapsed, NumMoved, PersistentVoxelData->GetNumAllocatedBricks());
+        }
+    }
+
+    double SnapshotStart = FPlatformTime::Seconds();
+
+    OutSnapshot.DirtyChunks.Reset();
+    CollectDirtyChunks(*PersistentVoxelData, OutSnapshot.DirtyChunks, OutSnapshot.bRebuildAll);
+
+    // 快照只复制这些分块提取时会读取的砖块
+    FIntVector BrickMin(MAX_int32, MAX_int32, MAX_int32);
+    FIntVector BrickMax(MIN_int32, MIN_int32, MIN_int32);
+    for (const FIntVector& ChunkCoord : OutSnapshot.DirtyChunks)
+    {
+        FIntVector ChunkBrickMin, ChunkBrickMax;
+        SurfaceMesher.GetChunkBrickRange(ChunkCoord, ChunkBrickMin, ChunkBrickMax);
+        BrickMin = FIntVector(FMath::Min(BrickMin.X, ChunkBrickMin.X), FMath::Min(BrickMin.Y, ChunkBrickMin.Y), FMath::Min(BrickMin.Z, ChunkBrickMin.Z));
+        BrickMax = FIntVector(FMath::Max(BrickMax.X, ChunkBrickMax.X), FMath::Max(BrickMax.Y, ChunkBrickMax.Y), FMath::Max(BrickMax.Z, ChunkBrickMax.Z));
+    }
+
+    TSharedPtr<FMaVoxelData, ESPMode::ThreadSafe>& Buffer = SnapshotBuffers[NextSnapshotBuffer];
+    NextSnapshotBuffer ^= 1;
+    if (!Buffer.IsValid())
+    {
+        Buffer = MakeShared<FMaVoxelData, ESPMode::ThreadSafe>();
+    }
+    Buffer->CopyRegionFrom(*PersistentVoxelData, BrickMin, BrickMax);
+    OutSnapshot.Voxels = Buffer;
+
+    double SnapshotEnd = FPlatformTime::Seconds();
+    UE_LOG(LogTemp, Log, TEXT("体素快照耗时: %.2f 毫秒, 分块数=%d, 复制砖块数=%d"),
+        (SnapshotEnd - SnapshotStart) * 1000.0, OutSnapshot.DirtyChunks.Num(), Buffer->GetNumAllocatedBricks());
+
+    return !(Progress && Progress->Cancelled());
+}
+
+void FVoxelCutMeshOp::GenerateMeshStage(const FVoxelMeshSnapshot& Snapshot, FProgressCancel* Progress)
+{
+    if (Progress && Progress->Cancelled()) return;
+
+    if (!Snapshot.IsValid())
+    {
+        return;
+    }
+
+    double GenerateStart = FPlatformTime::Seconds();
+
+    GenerateMeshFromChunks(*Snapshot.Voxels, Snapshot.DirtyChunks, Snapshot.bRebuildAll, Progress);
+
+    double GenerateEnd = FPlatformTime::Seconds();
+    UE_LOG(LogTemp, Warning, TEXT("模型生成耗时: %.2f 毫秒"), (GenerateEnd - GenerateStart) * 1000.0);
+}
+
+void FVoxelCutMeshOp::CollectDirtyChunks(const FMaVoxelData& Voxels, TArray<FIntVector>& OutChunks, bool& bOutRebuildAll)
+{
+    bOutRebuildAll = !bMeshChunksValid;
+    if (!bMeshChunksValid)
+    {
+        SurfaceMesher.Initialize(Voxels, MeshChunkBricks);
+        SurfaceMesher.GetAllChunks(OutChunks);
+        bMeshChunksValid = true;
+    }
+    else
+    {
+        SurfaceMesher.GetChunksInBounds(DirtyBounds, OutChunks);
+    }
+    DirtyBounds = FAxisAlignedBox3d::Empty();
+}
+
+void FVoxelCutMeshOp::GenerateMeshFromChunks(const FMaVoxelData& Voxels, const TArray<FIntVector>& DirtyChunks, bool bRebuildAll, FProgressCancel* Progress)
+{
+    if (bRebuildAll)
+    {
+        MeshChunks.Reset();
+        MeshChunks.SetNum(SurfaceMesher.GetNumChunks());
+    }
     
-    FMarchingCubes MarchingCubes;
-    // 使用八叉树边界
-    MarchingCubes.Bounds = Voxels.GetOctreeBounds();
-    MarchingCubes.CubeSize = Voxels.MarchingCubeSize;
+    double StartTime = FPlatformTime::Seconds();
+
+    // 各分块相互独立，并行提取
+    ParallelFor(DirtyChunks.Num(), [&](int32 Index)
+    {
+        const FIntVector& ChunkCoord = DirtyChunks[Index];
+        ExtractMeshChunk(Voxels, ChunkCoord, MeshChunks[SurfaceMesher.GetChunkIndex(ChunkCoord)]);
+    });
+
+    double ExtractTime = FPlatformTime::Seconds();
+
+    if (Progress && Progress->Cancelled()) return;
+
+    if (bOutputSections)
+    {
+        // 只生成被修改分块的分段，由调用方分别上传；合并网格不再跟随更新
+        MergedStates[0].bValid = false;
+        MergedStates[1].bValid = false;
+        BuildSectionMeshes(DirtyChunks);
+        UE_LOG(LogTemp, Warning, TEXT("Generated mesh sections: %d/%d (%.2f 毫秒)"),
+            ResultSections.Num(), MeshChunks.Num(), (ExtractTime - StartTime) * 1000.0);
+        return;
+    }
+
+    // 上一次的结果已被取走时，从缓冲环中取一个
+    if (!ResultMesh.IsValid())
+    {
+        ResultMesh = AcquireResultBuffer(ResultState);
+    }
+    else if (ResultState == INDEX_NONE)
+    {
+        // 操作器自带的初始结果网格
+        FScopeLock Lock(&ResultBufferLock);
+        ResultState = ClaimResultState();
+    }
+
+    // 替换被修改分块在合并网格中的部分
+    AssembleResultMesh(DirtyChunks, bRebuildAll);
     
-    // 使用八叉树进行采样
-    MarchingCubes.Implicit = [&Voxels](const FVector3d& Pos) -> double
+    UE_LOG(LogTemp, Warning, TEXT("Generated mesh triangle count: %d, 重新提取分块: %d/%d (%.2f 毫秒)"),
+        ResultMesh->TriangleCount(), DirtyChunks.Num(), MeshChunks.Num(), (ExtractTime - StartTime) * 1000.0);
+}
+
+void FVoxelCutMeshOp::BuildSectionMeshes(const TArray<FIntVector>& DirtyChunks)
+{
+    ResultSections.Reset();
+    ResultSections.SetNum(DirtyChunks.Num());
+
+    // 接缝顶点的法线和来自两侧的分块。接缝附近的表面变化必然落在脏区域的边距内，
+    // 所以累加受影响分块及其相邻分块即可得到完整的法线和
+    const FIntVector ChunkDims = SurfaceMesher.GetChunkDims();
+    TSet<int32> NormalSources;
+    for (const FIntVector& ChunkCoord : DirtyChunks)
+    {
+        for (int32 DZ = -1; DZ <= 1; DZ++)
+            for (int32 DY = -1; DY <= 1; DY++)
+                for (int32 DX = -1; DX <= 1; DX++)
+                {
+                    FIntVector Neighbor = ChunkCoord + FIntVector(DX, DY, DZ);
+                    if (Neighbor.X >= 0 && Neighbor.Y >= 0 && Neighbor.Z >= 0 &&
+                        Neighbor.X < ChunkDims.X && Neighbor.Y < ChunkDims.Y && Neighbor.Z < ChunkDims.Z)
+                    {
+                        NormalSources.Add(SurfaceMesher.GetChunkIndex(Neighbor));
+                    }
+                }
+    }
+
+    TMap<int64, FVector3d> SeamNormalSums;
+    for (int32 ChunkIndex : NormalSources)
+    {
+        const FVoxelSurfaceChunk& Chunk = MeshChunks[ChunkIndex];
+        for (int32 i = 0; i < Chunk.Vertices.Num(); i++)
+        {
+            if (Chunk.FixedVertices[i])
+            {
+                SeamNormalSums.FindOrAdd(Chunk.VertexKeys[i], FVector3d::Zero()) += Chunk.NormalSums[i];
+            }
+        }
+    }
+
+    ParallelFor(DirtyChunks.Num(), [&](int32 Index)
+    {
+        int32 ChunkIndex = SurfaceMesher.GetChunkIndex(DirtyChunks[Index]);
+        const FVoxelSurfaceChunk& Chunk = MeshChunks[ChunkIndex];
+
+        FVoxelMeshSection& Section = ResultSections[Index];
+        Section.ChunkIndex = ChunkIndex;
+        Section.Mesh = MakeUnique<FDynamicMesh3>();
+        Section.Mesh->EnableVertexNormals(FVector3f::UnitZ());
+
+        for (int32 i = 0; i < Chunk.Vertices.Num(); i++)
+        {
+            int32 VertexID = Section.Mesh->AppendVertex(Chunk.Vertices[i]);
+            const FVector3d& NormalSum = Chunk.FixedVertices[i] ? SeamNormalSums[Chunk.VertexKeys[i]] : Chunk.NormalSums[i];
+            Section.Mesh->SetVertexNormal(VertexID, (FVector3f)Normalized(NormalSum));
+        }
+        for (const FIndex3i& Tri : Chunk.Triangles)
+        {
+            Section.Mesh->AppendTriangle(Tri);
+        }
+    });
+}
+
+TUniquePtr<FDynamicMesh3> FVoxelCutMeshOp::AcquireResultBuffer(int32& OutState)
+{
+    FScopeLock Lock(&ResultBufferLock);
+
+    // 优先取内容已知、且不是调用方正在显示的缓冲区，只需重放之后修改过的分块
+    TUniquePtr<FDynamicMesh3> Buffer;
+    OutState = INDEX_NONE;
+    int32 PickIndex = FreeResultBuffers.IndexOfByPredicate([this](const FResultBuffer& Free)
+    {
+        return Free.State != INDEX_NONE && Free.State != DisplayedResultState;
+    });
+    if (PickIndex == INDEX_NONE && FreeResultBuffers.Num() > 0)
+    {
+        PickIndex = FreeResultBuffers.Num() - 1;
+    }
+    if (PickIndex != INDEX_NONE)
+    {
+        Buffer = MoveTemp(FreeResultBuffers[PickIndex].Mesh);
+        OutState = FreeResultBuffers[PickIndex].State;
+        FreeResultBuffers.RemoveAtSwap(PickIndex, 1, EAllowShrinking::No);
+    }
+    else
+    {
+        Buffer = MakeUnique<FDynamicMesh3>();
+    }
+
+    if (OutState == INDEX_NONE || OutState == DisplayedResultState)
+    {
+        OutState = ClaimResultState();
+    }
+    return Buffer;
+}
+
+int32 FVoxelCutMeshOp::ClaimResultState()
+{
+    // 内容未知的缓冲区：占用不在显示中的那份状态，整体重建（调用方持有 ResultBufferLock）
+    int32 State = (DisplayedResultState == 0) ? 1 : 0;
+    MergedStates[State].bValid = false;
+    for (FResultBuffer& Free : FreeResultBuffers)
+    {
+        if (Free.State == State)
+        {
+            Free.State = INDEX_NONE;
+        }
+    }
+    return State;
+}
+
+void FVoxelCutMeshOp::ReleaseResultBuffer(TUniquePtr<FDynamicMesh3> Buffer, bool bSwappedIn)
+{
+    FScopeLock Lock(&ResultBufferLock);
+
+    // 交换之后，归还的缓冲区里是之前显示的网格，交出的结果成为正在显示的网格
+    int32 BufferState = HandedOutResultState;
+    if (bSwappedIn)
+    {
+        BufferState = DisplayedResultState;
+        DisplayedResultState = HandedOutResultState;
+    }
+    HandedOutResultState = INDEX_NONE;
+
+    if (Buffer.IsValid() && FreeResultBuffers.Num() < MaxResultBuffers)
+    {
+        FreeResultBuffers.Add(FResultBuffer{MoveTemp(Buffer), BufferState});
+    }
+}
+
+void FVoxelCutMeshOp::ExtractMeshChunk(const FMaVoxelData& Voxels, const FIntVector& ChunkCoord, FVoxelSurfaceChunk& Chunk)
+{
+    // 直接从砖块提取表面
+    SurfaceMesher.ExtractChunk(Voxels, ChunkCoord, Chunk);
+    Chunk.NormalSums.SetNumZeroed(Chunk.Vertices.Num());
+    if (Chunk.Triangles.Num() == 0)
+    {
+        return;
+    }
+
+    if (SmoothingIteration > 0)
+    {
+        // 平滑模型（接缝顶点固定，保证与相邻分块一致）
+        FDynamicMesh3 ChunkMesh;
+        for (const FVector3d& Vertex : Chunk.Vertices)
+        {
+            ChunkMesh.AppendVertex(Vertex);
+        }
+        for (const FIndex3i& Tri : Chunk.Triangles)
+        {
+            ChunkMesh.AppendTriangle(Tri);
+        }
+        SmoothGeneratedMesh(ChunkMesh, SmoothingIteration, Chunk.FixedVertices);
+        for (int32 VertexID = 0; VertexID < Chunk.Vertices.Num(); VertexID++)
+        {
+            Chunk.Vertices[VertexID] = ChunkMesh.GetVertex(VertexID);
+        }
+    }
+
+    // 面积加权法线（与 VectorUtil::Normal 的左手系约定一致）
+    for (const FIndex3i& Tri : Chunk.Triangles)
+    {
+        const FVector3d& A = Chunk.Vertices[Tri.A];
+        const FVector3d& B = Chunk.Vertices[Tri.B];
+        const FVector3d& C = Chunk.Vertices[Tri.C];
+        FVector3d AreaNormal = 0.5 * (C - A).Cross(B - A);
+        Chunk.NormalSums[Tri.A] += AreaNormal;
+        Chunk.NormalSums[Tri.B] += AreaNormal;
+        Chunk.NormalSums[Tri.C] += AreaNormal;
+    }
+}
+
+void FVoxelCutMeshOp::AssembleResultMesh(const TArray<FIntVector>& DirtyChunks, bool bRebuildAll)
+{
+    // 直接在要交出的缓冲区上增量修改，不复制整个网格
+    FDynamicMesh3& Mesh = *ResultMesh;
+    FMergedMeshState& State = MergedStates[ResultState];
+    FMergedMeshState& OtherState = MergedStates[ResultState ^ 1];
+    if (bRebuildAll)
+    {
+        OtherState.bValid = false;
+    }
+    if (bRebuildAll || !State.bValid || State.Chunks.Num() != MeshChunks.Num())
+    {
+        Mesh.Clear();
+        Mesh.EnableVertexNormals(FVector3f::UnitZ());
+        State.Chunks.Reset();
+        State.Chunks.SetNum(MeshChunks.Num());
+        State.SeamVertices.Reset();
+        State.NormalSums.Reset();
+        State.PendingChunks.Reset();
+        State.bValid = true;
+        bRebuildAll = true;
+    }
+
+    // 本次修改的分块，加上该缓冲区上次写入之后在另一个缓冲区上修改过的分块
+    TArray<int32> ChunkIndices;
+    if (bRebuildAll)
+    {
+        for (int32 ChunkIndex = 0; ChunkIndex < MeshChunks.Num(); ChunkIndex++)
+        {
+            ChunkIndices.Add(ChunkIndex);
+        }
+    }
+    else
+    {
+        for (const FIntVector& ChunkCoord : DirtyChunks)
+        {
+            State.PendingChunks.Add(SurfaceMesher.GetChunkIndex(ChunkCoord));
+        }
+        ChunkIndices = State.PendingChunks.Array();
+    }
+    State.PendingChunks.Reset();
+    if (OtherState.bValid)
     {
-        return Voxels.GetValueAtPosition(Pos);
+        for (const FIntVector& ChunkCoord : DirtyChunks)
+        {
+            OtherState.PendingChunks.Add(SurfaceMesher.GetChunkIndex(ChunkCoord));
+        }
+    }
+
+    // 1. 移除这些分块上一次的三角形和顶点；接缝顶点只在最后一个引用它的分块移除时删除
+    for (int32 ChunkIndex : ChunkIndices)
+    {
+        FMergedChunk& Merged = State.Chunks[ChunkIndex];
+        for (int32 TriangleID : Merged.TriangleIDs)
+        {
+            Mesh.RemoveTriangle(TriangleID, false, false);
+        }
+        for (int32 i = 0; i < Merged.VertexIDs.Num(); i++)
+        {
+            const int32 VertexID = Merged.VertexIDs[i];
+            if (Merged.SeamKeys[i] != INDEX_NONE)
+            {
+                State.NormalSums[VertexID] -= Merged.NormalSums[i];
+                FMergedSeamVertex& Seam = State.SeamVertices.FindChecked(Merged.SeamKeys[i]);
+                if (--Seam.RefCount > 0)
+                {
+                    continue;
+                }
+                State.SeamVertices.Remove(Merged.SeamKeys[i]);
+            }
+            Mesh.RemoveVertex(VertexID, false);
+        }
+        Merged.VertexIDs.Reset();
+        Merged.SeamKeys.Reset();
+        Merged.NormalSums.Reset();
+        Merged.TriangleIDs.Reset();
+    }
+
+    // 2. 加入新提取的内容，接缝顶点与相邻分块共用
+    auto AppendMergedVertex = [&Mesh, &State](const FVector3d& Position)
+    {
+        int32 VertexID = Mesh.AppendVertex(Position);
+        if (VertexID >= State.NormalSums.Num())
+        {
+            State.NormalSums.SetNumZeroed(VertexID + 1);
+        }
+        State.NormalSums[VertexID] = FVector3d::Zero();
+        return VertexID;
     };
 
-    MarchingCubes.IsoValue = 0.0f;
-    
-    ResultMesh->Copy(&MarchingCubes.Generate());
+    TArray<int32> TouchedVertices;
+    for (int32 ChunkIndex : ChunkIndices)
+    {
+        const FVoxelSurfaceChunk& Chunk = MeshChunks[ChunkIndex];
+        FMergedChunk& Merged = State.Chunks[ChunkIndex];
+        Merged.VertexIDs.SetNumUninitialized(Chunk.Vertices.Num());
+        Merged.SeamKeys.SetNumUninitialized(Chunk.Vertices.Num());
+        Merged.NormalSums = Chunk.NormalSums;
 
-    // 平滑模型
-    SmoothGeneratedMesh(*ResultMesh, SmoothingIteration);
-    
-    UE_LOG(LogTemp, Warning, TEXT("Generated mesh triangle count: %d"), ResultMesh->TriangleCount());
-    
-    if (ResultMesh->TriangleCount() > 0)
+        for (int32 i = 0; i < Chunk.Vertices.Num(); i++)
+        {
+            int32 VertexID = INDEX_NONE;
+            if (Chunk.FixedVertices[i])
+            {
+                FMergedSeamVertex& Seam = State.SeamVertices.FindOrAdd(Chunk.VertexKeys[i]);
+                if (Seam.RefCount == 0)
+                {
+                    Seam.VertexID = AppendMergedVertex(Chunk.Vertices[i]);
+                }
+                Seam.RefCount++;
+                VertexID = Seam.VertexID;
+                Merged.SeamKeys[i] = Chunk.VertexKeys[i];
+            }
+            else
+            {
+                VertexID = AppendMergedVertex(Chunk.Vertices[i]);
+                Merged.SeamKeys[i] = INDEX_NONE;
+            }
+            State.NormalSums[VertexID] += Chunk.NormalSums[i];
+            Merged.VertexIDs[i] = VertexID;
+            TouchedVertices.Add(VertexID);
+        }
+
+        Merged.TriangleIDs.Reserve(Chunk.Triangles.Num());
+        for (const FIndex3i& Tri : Chunk.Triangles)
+        {
+            int32 TriangleID = Mesh.AppendTriangle(Merged.VertexIDs[Tri.A], Merged.VertexIDs[Tri.B], Merged.VertexIDs[Tri.C]);
+            if (TriangleID >= 0)
+            {
+                Merged.TriangleIDs.Add(TriangleID);
+            }
+        }
+    }
+
+    // 3. 接缝两侧的法线和已经合并，只需重新归一化受影响的顶点
+    for (int32 VertexID : TouchedVertices)
     {
-        ResultMesh->ReverseOrientation(true);
-        FMeshNormals::QuickComputeVertexNormals(*ResultMesh);
-        
-        // 复原位置
-        FTransform InverseTargetTransform = TargetTransform.Inverse();
-        MeshTransforms::ApplyTransform(*ResultMesh, InverseTargetTransform, true);
+        Mesh.SetVertexNormal(VertexID, (FVector3f)Normalized(State.NormalSums[VertexID]));
     }
+
+    FScopeLock Lock(&ResultBufferLock);
+    HandedOutResultState = ResultState;
 }
 
-void FVoxelCutMeshOp::SmoothGeneratedMesh(FDynamicMesh3& Mesh, int32 Iterations)
+void FVoxelCutMeshOp::SmoothGeneratedMesh(FDynamicMesh3& Mesh, int32 Iterations, const TArray<bool>& FixedVertices)
 {
     if (Mesh.VertexCount() == 0) return;
     
@@ -253,6 +999,12 @@ void FVoxelCutMeshOp::SmoothGeneratedMesh(FDynamicMesh3& Mesh, int32 Iterations)
         for (int32 VertexID : Mesh.VertexIndicesItr())
         {
             FVector3d CurrentPos = Mesh.GetVertex(VertexID);
+            if (FixedVertices.IsValidIndex(VertexID) && FixedVertices[VertexID])
+            {
+                NewPositions[VertexID] = CurrentPos;
+                continue;
+            }
+            
             FVector3d NeighborAverage = FVector3d::Zero();
             int32 NeighborCount = 0;
             
@@ -281,9 +1033,4 @@ void FVoxelCutMeshOp::SmoothGeneratedMesh(FDynamicMesh3& Mesh, int32 Iterations)
             Mesh.SetVertex(VertexID, NewPositions[VertexID]);
         }
     }
-    
-    // 重新计算法线
-    FMeshNormals::QuickComputeVertexNormals(Mesh);
 }
-
-UE_ENABLE_OPTIMIZATION
@@ -0,0 +1,185 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelCutSubsystem.h"
+
+#include "VoxelCutComponent.h"
+#include "Algo/Sort.h"
+#include "Async/Async.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Tasks/Task.h"
+
+static int32 GVoxelMaxConcurrentCutJobs = 0;
+static FAutoConsoleVariableRef CVarVoxelMaxConcurrentCutJobs(TEXT("p.Voxel.MaxConcurrentCutJobs"), GVoxelMaxConcurrentCutJobs,
+    TEXT("同时运行的切削后台任务数上限（0 表示取工作线程数的一半）"));
+
+bool UVoxelCutSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+    return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UVoxelCutSubsystem::Deinitialize()
+{
+    // 已提交的任务持有各自操作器的共享引用，自行结束；排队中的直接丢弃
+    QueuedJobs.Empty();
+    CutComponents.Empty();
+
+    Super::Deinitialize();
+}
+
+TStatId UVoxelCutSubsystem::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(UVoxelCutSubsystem, STATGROUP_Tickables);
+}
+
+void UVoxelCutSubsystem::RegisterCutComponent(UVoxelCutComponent* Component)
+{
+    if (Component)
+    {
+        CutComponents.AddUnique(Component);
+    }
+}
+
+void UVoxelCutSubsystem::UnregisterCutComponent(UVoxelCutComponent* Component)
+{
+    CutComponents.Remove(Component);
+    QueuedJobs.RemoveAll([Component](const FQueuedJob& Job)
+    {
+        return !Job.Owner.IsValid() || Job.Owner.Get() == Component;
+    });
+}
+
+void UVoxelCutSubsystem::EnqueueJob(UVoxelCutComponent* Owner, TUniqueFunction<void()> Job)
+{
+    FQueuedJob& Queued = QueuedJobs.AddDefaulted_GetRef();
+    Queued.Owner = Owner;
+    Queued.Work = MoveTemp(Job);
+    Queued.Sequence = NextJobSequence++;
+
+    // 帧内 Tick 期间提交的任务留到帧末统一排序；任务完成回调中提交的后续阶段
+    // （例如阶段一完成后的网格生成）有空闲槽位时立即开始，不必等到下一帧
+    if (!bTickingComponents)
+    {
+        LaunchQueuedJobs();
+    }
+}
+
+void UVoxelCutSubsystem::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+
+    // 宽相位：刀具与目标的包围盒不重叠时，组件只记录刀具位姿而不产生切削请求
+    bTickingComponents = true;
+    for (int32 Index = CutComponents.Num() - 1; Index >= 0; Index--)
+    {
+        UVoxelCutComponent* Component = CutComponents[Index].Get();
+        if (!Component)
+        {
+            CutComponents.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+            continue;
+        }
+        Component->TickCut(Component->IsToolNearTarget());
+    }
+    bTickingComponents = false;
+
+    LaunchQueuedJobs();
+}
+
+float UVoxelCutSubsystem::ComputePriority(const UVoxelCutComponent* Component, const FVector* ViewLocation) const
+{
+    const FBox TargetBounds = Component->GetTargetWorldBounds();
+    if (!TargetBounds.IsValid)
+    {
+        return 0.0f;
+    }
+
+    if (ViewLocation)
+    {
+        // 屏幕尺寸近似为包围球半径与视距之比
+        double ViewDistance = FMath::Max(FVector::Distance(*ViewLocation, TargetBounds.GetCenter()), 1.0);
+        return (float)(TargetBounds.GetExtent().Size() / ViewDistance);
+    }
+
+    // 没有视点（例如专用服务器）时，刀具越靠近目标越优先
+    return (float)(1.0 / (1.0 + Component->GetToolDistanceToTarget()));
+}
+
+int32 UVoxelCutSubsystem::GetMaxConcurrentJobs() const
+{
+    if (GVoxelMaxConcurrentCutJobs > 0)
+    {
+        return GVoxelMaxConcurrentCutJobs;
+    }
+    // 每个任务内部还会 ParallelFor，只占用一半的工作线程
+    return FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads() / 2);
+}
+
+void UVoxelCutSubsystem::LaunchQueuedJobs()
+{
+    if (QueuedJobs.Num() == 0)
+    {
+        return;
+    }
+
+    const int32 FreeSlots = GetMaxConcurrentJobs() - RunningJobs->GetValue();
+    if (FreeSlots <= 0)
+    {
+        return;
+    }
+
+    // 视点取第一个本地玩家的相机
+    FVector ViewLocation = FVector::ZeroVector;
+    bool bHasView = false;
+    if (APlayerController* PlayerController = GetWorld()->GetFirstPlayerController())
+    {
+        if (PlayerController->PlayerCameraManager)
+        {
+            ViewLocation = PlayerController->PlayerCameraManager->GetCameraLocation();
+            bHasView = true;
+        }
+    }
+
+    for (FQueuedJob& Job : QueuedJobs)
+    {
+        const UVoxelCutComponent* Owner = Job.Owner.Get();
+        Job.Priority = Owner ? ComputePriority(Owner, bHasView ? &ViewLocation : nullptr) : -1.0f;
+    }
+    Algo::Sort(QueuedJobs, [](const FQueuedJob& A, const FQueuedJob& B)
+    {
+        return A.Priority != B.Priority ? A.Priority > B.Priority : A.Sequence < B.Sequence;
+    });
+
+    // 本帧的任务一次性提交，超出并发上限的留到下一帧重新排序
+    int32 NumLaunched = 0;
+    int32 NumConsumed = 0;
+    for (; NumConsumed < QueuedJobs.Num() && NumLaunched < FreeSlots; NumConsumed++)
+    {
+        FQueuedJob& Job = QueuedJobs[NumConsumed];
+        if (!Job.Owner.IsValid())
+        {
+            // 组件已销毁，结果也没有人接收
+            continue;
+        }
+
+        RunningJobs->Increment();
+        UE::Tasks::Launch(TEXT("VoxelCutJob"), [Work = MoveTemp(Job.Work), Running = RunningJobs, WeakThis = TWeakObjectPtr<UVoxelCutSubsystem>(this)]() mutable
+        {
+            Work();
+            Running->Decrement();
+
+            // 槽位空出后马上提交排队中的任务，受并发上限阻塞的任务不用再等一帧
+            Async(EAsyncExecution::TaskGraphMainThread, [WeakThis]()
+            {
+                if (UVoxelCutSubsystem* This = WeakThis.Get())
+                {
+                    This->LaunchQueuedJobs();
+                }
+            });
+        });
+        NumLaunched++;
+    }
+    QueuedJobs.RemoveAt(0, NumConsumed, EAllowShrinking::No);
+}
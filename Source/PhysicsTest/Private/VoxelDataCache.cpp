@@ -0,0 +1,278 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelDataCache.h"
+
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+
+namespace
+{
+    constexpr uint32 CacheMagic = 0x58564D41; // "AMVX"
+
+    // 文件头，所有字段定长，按原样写入
+    struct FVoxelCacheHeader
+    {
+        uint32 Magic;
+        uint32 Version;
+        uint8 KeyHash[20];
+        double BoundsMin[3];
+        double BoundsMax[3];
+        double VoxelSize;
+        double MarchingCubeSize;
+        double MinVoxelSize;
+        double QuantizeBandVoxels;
+        int32 MaxOctreeDepth;
+        int32 StorageFormat;
+        int32 BrickDims[3];
+        int32 NumTableEntries;
+        int32 NumPoolSlots;
+        int64 TableOffset;
+        int64 CoordsOffset;
+        int64 ScalesOffset;
+        int64 PoolOffset;
+        int64 FileSize;
+    };
+
+    static_assert(sizeof(FVoxelBrickCell) == 8, "FVoxelBrickCell layout is part of the cache format");
+    static_assert(sizeof(FIntVector) == 12, "FIntVector layout is part of the cache format");
+
+    template<typename T>
+    void HashValue(FSHA1& Sha, const T& Value)
+    {
+        Sha.Update(reinterpret_cast<const uint8*>(&Value), sizeof(T));
+    }
+}
+
+FString FVoxelDataCache::ComputeKey(const FDynamicMesh3& Mesh, const FMaVoxelData& Params, EVoxelizeMethod Method)
+{
+    FSHA1 Sha;
+    HashValue(Sha, FormatVersion);
+    HashValue(Sha, (uint8)Method);
+    HashValue(Sha, FMaVoxelData::BrickSize);
+    HashValue(Sha, Params.MarchingCubeSize);
+    HashValue(Sha, Params.MaxOctreeDepth);
+    HashValue(Sha, Params.MinVoxelSize);
+    HashValue(Sha, (uint8)Params.StorageFormat);
+    HashValue(Sha, Params.QuantizeBandVoxels);
+
+    // 网格按紧凑顺序哈希，与内部的空洞和元素编号无关
+    HashValue(Sha, Mesh.VertexCount());
+    HashValue(Sha, Mesh.TriangleCount());
+    for (int32 TriangleID : Mesh.TriangleIndicesItr())
+    {
+        FVector3d A, B, C;
+        Mesh.GetTriVertices(TriangleID, A, B, C);
+        HashValue(Sha, A);
+        HashValue(Sha, B);
+        HashValue(Sha, C);
+    }
+
+    Sha.Final();
+    FSHAHash Hash;
+    Sha.GetHash(Hash.Hash);
+    return Hash.ToString();
+}
+
+FString FVoxelDataCache::GetCacheFilePath(const FString& Key)
+{
+    return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("VoxelCache"), Key + TEXT(".mavox"));
+}
+
+bool FVoxelDataCache::Load(const FString& Key, FMaVoxelData& OutData)
+{
+    double StartTime = FPlatformTime::Seconds();
+    FString Path = GetCacheFilePath(Key);
+
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    if (!PlatformFile.FileExists(*Path))
+    {
+        return false;
+    }
+
+    // 映射整个文件，各段直接从映射区复制到目标数组；不支持映射的平台退回为整体读入
+    TUniquePtr<IMappedFileHandle> MappedFile(PlatformFile.OpenMapped(*Path));
+    TUniquePtr<IMappedFileRegion> Region;
+    TArray64<uint8> FileBytes;
+    if (MappedFile.IsValid() && MappedFile->GetFileSize() > 0)
+    {
+        Region.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+    }
+    if (!Region.IsValid() && !FFileHelper::LoadFileToArray(FileBytes, *Path))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("体素缓存无法读取: %s"), *Path);
+        return false;
+    }
+
+    const uint8* Data = Region.IsValid() ? Region->GetMappedPtr() : FileBytes.GetData();
+    const int64 FileSize = Region.IsValid() ? Region->GetMappedSize() : FileBytes.Num();
+    if (FileSize < (int64)sizeof(FVoxelCacheHeader))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("体素缓存无效或版本不符: %s"), *Path);
+        return false;
+    }
+    FVoxelCacheHeader Header;
+    FMemory::Memcpy(&Header, Data, sizeof(Header));
+
+    // 校验版本、键和各段范围
+    FSHAHash ExpectedHash;
+    ExpectedHash.FromString(Key);
+    const int64 NumTable = Header.NumTableEntries;
+    const int64 NumBricks = Header.NumPoolSlots;
+    const int64 NumScales = (Header.StorageFormat == (int32)EVoxelStorageFormat::Float32) ? 0 : NumBricks;
+    if (Header.Magic != CacheMagic || Header.Version != FormatVersion ||
+        FMemory::Memcmp(Header.KeyHash, ExpectedHash.Hash, sizeof(Header.KeyHash)) != 0 ||
+        Header.FileSize != FileSize ||
+        Header.StorageFormat < 0 || Header.StorageFormat > (int32)EVoxelStorageFormat::Int8 ||
+        Header.BrickDims[0] <= 0 || Header.BrickDims[1] <= 0 || Header.BrickDims[2] <= 0 || NumBricks < 0 ||
+        NumTable != (int64)Header.BrickDims[0] * Header.BrickDims[1] * Header.BrickDims[2] ||
+        Header.TableOffset < (int64)sizeof(FVoxelCacheHeader) || Header.CoordsOffset < 0 || Header.ScalesOffset < 0 || Header.PoolOffset < 0 ||
+        Header.TableOffset + NumTable * (int64)sizeof(FVoxelBrickCell) > FileSize ||
+        Header.CoordsOffset + NumBricks * (int64)sizeof(FIntVector) > FileSize ||
+        Header.ScalesOffset + NumScales * (int64)sizeof(float) > FileSize)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("体素缓存无效或版本不符: %s"), *Path);
+        return false;
+    }
+
+    OutData.Reset();
+    OutData.MarchingCubeSize = Header.MarchingCubeSize;
+    OutData.MaxOctreeDepth = Header.MaxOctreeDepth;
+    OutData.MinVoxelSize = Header.MinVoxelSize;
+    OutData.QuantizeBandVoxels = Header.QuantizeBandVoxels;
+    OutData.StorageFormat = (EVoxelStorageFormat)Header.StorageFormat;
+    OutData.Bounds = FAxisAlignedBox3d(
+        FVector3d(Header.BoundsMin[0], Header.BoundsMin[1], Header.BoundsMin[2]),
+        FVector3d(Header.BoundsMax[0], Header.BoundsMax[1], Header.BoundsMax[2]));
+    OutData.VoxelSize = Header.VoxelSize;
+    OutData.BrickDims = FIntVector(Header.BrickDims[0], Header.BrickDims[1], Header.BrickDims[2]);
+
+    // 砖块池按字节存放在 TArray 中，不能超过 int32 可索引的范围
+    const int64 PoolBytes = NumBricks * OutData.GetBrickStride();
+    if (PoolBytes > MAX_int32 || Header.PoolOffset + PoolBytes > FileSize)
+    {
+        OutData.Reset();
+        UE_LOG(LogTemp, Warning, TEXT("体素缓存无效或版本不符: %s"), *Path);
+        return false;
+    }
+
+    // 各段与内存布局一致，整体复制（砖块池在切削时原地修改，不能直接指向只读映射）
+    OutData.BrickTable.SetNumUninitialized(NumTable);
+    FMemory::Memcpy(OutData.BrickTable.GetData(), Data + Header.TableOffset, NumTable * sizeof(FVoxelBrickCell));
+    OutData.BrickCoords.SetNumUninitialized(NumBricks);
+    FMemory::Memcpy(OutData.BrickCoords.GetData(), Data + Header.CoordsOffset, NumBricks * sizeof(FIntVector));
+    OutData.BrickScales.SetNumUninitialized(NumScales);
+    FMemory::Memcpy(OutData.BrickScales.GetData(), Data + Header.ScalesOffset, NumScales * sizeof(float));
+    OutData.BrickPool.SetNumUninitialized(PoolBytes);
+    FMemory::Memcpy(OutData.BrickPool.GetData(), Data + Header.PoolOffset, PoolBytes);
+    bool bValid = true;
+
+    // 索引表与槽位坐标必须一一对应，损坏的文件在这里被拒绝，而不是在第一次采样时越界
+    int32 NumAllocated = 0;
+    for (int32 LinearIndex = 0; bValid && LinearIndex < NumTable; LinearIndex++)
+    {
+        const int32 PoolIndex = OutData.BrickTable[LinearIndex].PoolIndex;
+        if (PoolIndex == INDEX_NONE)
+        {
+            continue;
+        }
+        const FIntVector BrickCoord(
+            LinearIndex % OutData.BrickDims.X,
+            (LinearIndex / OutData.BrickDims.X) % OutData.BrickDims.Y,
+            LinearIndex / (OutData.BrickDims.X * OutData.BrickDims.Y));
+        bValid = PoolIndex >= 0 && PoolIndex < NumBricks && OutData.BrickCoords[PoolIndex] == BrickCoord;
+        NumAllocated++;
+    }
+    for (int32 PoolIndex = 0; bValid && PoolIndex < NumBricks; PoolIndex++)
+    {
+        if (!OutData.IsPoolSlotInUse(PoolIndex))
+        {
+            OutData.FreeBrickSlots.Add(PoolIndex);
+        }
+    }
+    if (!bValid || NumAllocated != OutData.GetNumAllocatedBricks())
+    {
+        OutData.Reset();
+        UE_LOG(LogTemp, Warning, TEXT("体素缓存内容损坏: %s"), *Path);
+        return false;
+    }
+
+    double EndTime = FPlatformTime::Seconds();
+    UE_LOG(LogTemp, Warning, TEXT("体素缓存加载耗时: %.2f 毫秒, 已分配砖块=%lld (%s)"), (EndTime - StartTime) * 1000.0, NumBricks, *Path);
+    return true;
+}
+
+bool FVoxelDataCache::Save(const FString& Key, const FMaVoxelData& Data)
+{
+    // 细化网格依赖父级，只缓存构建结果
+    if (!Data.IsValid() || Data.IsRefined())
+    {
+        return false;
+    }
+
+    FString Path = GetCacheFilePath(Key);
+    FString TempPath = Path + TEXT(".tmp");
+
+    FVoxelCacheHeader Header;
+    FMemory::Memzero(Header);
+    Header.Magic = CacheMagic;
+    Header.Version = FormatVersion;
+    FSHAHash KeyHash;
+    KeyHash.FromString(Key);
+    FMemory::Memcpy(Header.KeyHash, KeyHash.Hash, sizeof(Header.KeyHash));
+    for (int32 Axis = 0; Axis < 3; Axis++)
+    {
+        Header.BoundsMin[Axis] = Data.Bounds.Min[Axis];
+        Header.BoundsMax[Axis] = Data.Bounds.Max[Axis];
+        Header.BrickDims[Axis] = Data.BrickDims[Axis];
+    }
+    Header.VoxelSize = Data.VoxelSize;
+    Header.MarchingCubeSize = Data.MarchingCubeSize;
+    Header.MinVoxelSize = Data.MinVoxelSize;
+    Header.QuantizeBandVoxels = Data.QuantizeBandVoxels;
+    Header.StorageFormat = (int32)Data.StorageFormat;
+    Header.MaxOctreeDepth = Data.MaxOctreeDepth;
+    Header.NumTableEntries = Data.BrickTable.Num();
+    Header.NumPoolSlots = Data.GetNumPoolSlots();
+
+    const int64 TableBytes = (int64)Data.BrickTable.Num() * sizeof(FVoxelBrickCell);
+    const int64 CoordsBytes = (int64)Data.BrickCoords.Num() * sizeof(FIntVector);
+    const int64 ScalesBytes = (int64)Data.BrickScales.Num() * sizeof(float);
+    const int64 PoolBytes = Data.BrickPool.Num();
+    Header.TableOffset = sizeof(FVoxelCacheHeader);
+    Header.CoordsOffset = Header.TableOffset + TableBytes;
+    Header.ScalesOffset = Header.CoordsOffset + CoordsBytes;
+    Header.PoolOffset = Align(Header.ScalesOffset + ScalesBytes, 64);
+    Header.FileSize = Header.PoolOffset + PoolBytes;
+
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TempPath));
+    if (!Writer.IsValid())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("体素缓存无法写入: %s"), *TempPath);
+        return false;
+    }
+
+    Writer->Serialize(&Header, sizeof(Header));
+    Writer->Serialize(const_cast<FVoxelBrickCell*>(Data.BrickTable.GetData()), TableBytes);
+    Writer->Serialize(const_cast<FIntVector*>(Data.BrickCoords.GetData()), CoordsBytes);
+    Writer->Serialize(const_cast<float*>(Data.BrickScales.GetData()), ScalesBytes);
+    uint8 Padding[64] = {};
+    Writer->Serialize(Padding, Header.PoolOffset - (Header.ScalesOffset + ScalesBytes));
+    Writer->Serialize(const_cast<uint8*>(Data.BrickPool.GetData()), PoolBytes);
+    bool bWriteOk = !Writer->IsError() && Writer->Close();
+    Writer.Reset();
+
+    if (!bWriteOk || !IFileManager::Get().Move(*Path, *TempPath, true))
+    {
+        IFileManager::Get().Delete(*TempPath);
+        UE_LOG(LogTemp, Warning, TEXT("体素缓存写入失败: %s"), *Path);
+        return false;
+    }
+
+    UE_LOG(LogTemp, Log, TEXT("体素缓存已写入: %s (%.2f MB)"), *Path, Header.FileSize / (1024.0 * 1024.0));
+    return true;
+}
@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelKernels.h"
+
+#include "HAL/IConsoleManager.h"
+
+#if INTEL_ISPC
+#include "VoxelKernels.ispc.generated.h"
+
+static_assert((int32)EVoxelCSGOperation::Subtract == 0 && (int32)EVoxelCSGOperation::Union == 1 &&
+              (int32)EVoxelCSGOperation::Intersect == 2 && (int32)EVoxelCSGOperation::SmoothSubtract == 3 &&
+              (int32)EVoxelCSGOperation::SmoothUnion == 4, "EVoxelCSGOperation must match VoxelKernels.ispc");
+#endif
+
+#if !defined(VOXEL_ISPC_ENABLED_DEFAULT)
+#define VOXEL_ISPC_ENABLED_DEFAULT 1
+#endif
+
+// 非发行版本支持运行时切换
+#if !INTEL_ISPC || UE_BUILD_SHIPPING
+static constexpr bool bVoxel_ISPC_Enabled = INTEL_ISPC && VOXEL_ISPC_ENABLED_DEFAULT;
+#else
+static bool bVoxel_ISPC_Enabled = VOXEL_ISPC_ENABLED_DEFAULT;
+static FAutoConsoleVariableRef CVarVoxelISPCEnabled(TEXT("p.Voxel.ISPC"), bVoxel_ISPC_Enabled,
+    TEXT("体素砖块内核是否使用 ISPC 实现（关闭时使用标量实现）"));
+#endif
+
+namespace VoxelKernels
+{
+    bool IsISPCEnabled()
+    {
+        return bVoxel_ISPC_Enabled;
+    }
+
+    void TrilinearBatch(const float* Corners, int32 CornerStride, const float* U, const float* V, const float* W,
+                        float* Out, int32 Count)
+    {
+        if (bVoxel_ISPC_Enabled)
+        {
+#if INTEL_ISPC
+            ispc::TrilinearBatch(Corners, CornerStride, U, V, W, Out, Count);
+#endif
+            return;
+        }
+
+        auto VectorLerp = [](const VectorRegister4Float& A, const VectorRegister4Float& B, const VectorRegister4Float& T)
+        {
+            return VectorMultiplyAdd(VectorSubtract(B, A), T, A);
+        };
+        auto Corner = [Corners, CornerStride](int32 c, int32 i) { return Corners + c * CornerStride + i; };
+
+        // 每次 4 个采样
+        int32 i = 0;
+        for (; i + 4 <= Count; i += 4)
+        {
+            VectorRegister4Float VU = VectorLoadAligned(U + i);
+            VectorRegister4Float VV = VectorLoadAligned(V + i);
+            VectorRegister4Float VW = VectorLoadAligned(W + i);
+
+            VectorRegister4Float X00 = VectorLerp(VectorLoadAligned(Corner(0, i)), VectorLoadAligned(Corner(1, i)), VU);
+            VectorRegister4Float X10 = VectorLerp(VectorLoadAligned(Corner(2, i)), VectorLoadAligned(Corner(3, i)), VU);
+            VectorRegister4Float X01 = VectorLerp(VectorLoadAligned(Corner(4, i)), VectorLoadAligned(Corner(5, i)), VU);
+            VectorRegister4Float X11 = VectorLerp(VectorLoadAligned(Corner(6, i)), VectorLoadAligned(Corner(7, i)), VU);
+
+            VectorRegister4Float Y0 = VectorLerp(X00, X10, VV);
+            VectorRegister4Float Y1 = VectorLerp(X01, X11, VV);
+
+            VectorStore(VectorLerp(Y0, Y1, VW), Out + i);
+        }
+        for (; i < Count; i++)
+        {
+            float X00 = FMath::Lerp(*Corner(0, i), *Corner(1, i), U[i]);
+            float X10 = FMath::Lerp(*Corner(2, i), *Corner(3, i), U[i]);
+            float X01 = FMath::Lerp(*Corner(4, i), *Corner(5, i), U[i]);
+            float X11 = FMath::Lerp(*Corner(6, i), *Corner(7, i), U[i]);
+            Out[i] = FMath::Lerp(FMath::Lerp(X00, X10, V[i]), FMath::Lerp(X01, X11, V[i]), W[i]);
+        }
+    }
+
+    void BrickMinMax(const float* Values, int32 Count, float& OutMin, float& OutMax)
+    {
+        if (bVoxel_ISPC_Enabled)
+        {
+#if INTEL_ISPC
+            ispc::BrickMinMax(Values, Count, OutMin, OutMax);
+#endif
+            return;
+        }
+
+        OutMin = Values[0];
+        OutMax = Values[0];
+        for (int32 i = 1; i < Count; i++)
+        {
+            OutMin = FMath::Min(OutMin, Values[i]);
+            OutMax = FMath::Max(OutMax, Values[i]);
+        }
+    }
+
+    float ApplyCSGScalar(EVoxelCSGOperation Operation, float Target, float Tool, float Smoothness)
+    {
+        // 平滑版本使用多项式平滑最值，Smoothness 为过渡宽度
+        switch (Operation)
+        {
+        case EVoxelCSGOperation::Union:
+            return FMath::Min(Target, Tool);
+        case EVoxelCSGOperation::Intersect:
+            return FMath::Max(Target, Tool);
+        case EVoxelCSGOperation::SmoothSubtract:
+            if (Smoothness > 0.0f)
+            {
+                float H = FMath::Clamp(0.5f - 0.5f * (Target + Tool) / Smoothness, 0.0f, 1.0f);
+                return FMath::Lerp(Target, -Tool, H) + Smoothness * H * (1.0f - H);
+            }
+            return FMath::Max(Target, -Tool);
+        case EVoxelCSGOperation::SmoothUnion:
+            if (Smoothness > 0.0f)
+            {
+                float H = FMath::Clamp(0.5f + 0.5f * (Tool - Target) / Smoothness, 0.0f, 1.0f);
+                return FMath::Lerp(Tool, Target, H) - Smoothness * H * (1.0f - H);
+            }
+            return FMath::Min(Target, Tool);
+        default:
+            return FMath::Max(Target, -Tool);
+        }
+    }
+
+    int32 ApplyCSG(float* Target, const float* Tool, int32 Count,
+                   EVoxelCSGOperation Operation, float Smoothness, float OutsideDistance)
+    {
+        if (bVoxel_ISPC_Enabled)
+        {
+#if INTEL_ISPC
+            return ispc::ApplyCSG(Target, Tool, Count, (int32)Operation, Smoothness, OutsideDistance);
+#endif
+        }
+
+        int32 Changed = 0;
+        for (int32 i = 0; i < Count; i++)
+        {
+            float Result;
+            if (Tool[i] == ToolNotCovered)
+            {
+                // 远离刀具：只有求交会改变这些体素（刀具外部全部变为空）
+                Result = Operation == EVoxelCSGOperation::Intersect ? FMath::Max(Target[i], OutsideDistance) : Target[i];
+            }
+            else
+            {
+                Result = ApplyCSGScalar(Operation, Target[i], Tool[i], Smoothness);
+            }
+            Changed += (Result != Target[i]) ? 1 : 0;
+            Target[i] = Result;
+        }
+        return Changed;
+    }
+}
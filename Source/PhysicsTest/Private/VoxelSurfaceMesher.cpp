@@ -0,0 +1,281 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelSurfaceMesher.h"
+
+using namespace UE::Geometry;
+
+void FVoxelSurfaceMesher::Initialize(const FMaVoxelData& Voxels, int32 InChunkBricks)
+{
+    // 格点间隔尽量接近 MarchingCubeSize，并取能整除砖块尺寸的 2 的幂，保证单元不跨越格点错位
+    Stride = 1;
+    while (Stride * 2 <= FMaVoxelData::BrickSize && Stride * 2 * Voxels.VoxelSize <= Voxels.MarchingCubeSize + KINDA_SMALL_NUMBER)
+    {
+        Stride *= 2;
+    }
+
+    LatticeDims = Voxels.GetSampleDims() / Stride;
+    CellDims = LatticeDims - FIntVector(1, 1, 1);
+    ChunkCells = FMath::Max(1, InChunkBricks) * FMaVoxelData::BrickSize / Stride;
+    ChunkDims = FIntVector(
+        FMath::Max(1, FMath::DivideAndRoundUp(CellDims.X, ChunkCells)),
+        FMath::Max(1, FMath::DivideAndRoundUp(CellDims.Y, ChunkCells)),
+        FMath::Max(1, FMath::DivideAndRoundUp(CellDims.Z, ChunkCells)));
+    Origin = Voxels.Bounds.Min;
+    CellSize = Voxels.VoxelSize * Stride;
+}
+
+void FVoxelSurfaceMesher::GetAllChunks(TArray<FIntVector>& OutChunks) const
+{
+    for (int32 Z = 0; Z < ChunkDims.Z; Z++)
+        for (int32 Y = 0; Y < ChunkDims.Y; Y++)
+            for (int32 X = 0; X < ChunkDims.X; X++)
+                OutChunks.Add(FIntVector(X, Y, Z));
+}
+
+void FVoxelSurfaceMesher::GetChunksInBounds(const FAxisAlignedBox3d& InBounds, TArray<FIntVector>& OutChunks) const
+{
+    if (InBounds.IsEmpty()) return;
+
+    // 一个格点的值会影响相邻单元的顶点，以及使用这些顶点的相邻一圈面片
+    double Margin = 2.0 * CellSize;
+    FVector3d MinCoord = (InBounds.Min - FVector3d(Margin) - Origin) / (CellSize * ChunkCells);
+    FVector3d MaxCoord = (InBounds.Max + FVector3d(Margin) - Origin) / (CellSize * ChunkCells);
+    FIntVector ChunkMin(
+        FMath::Max(0, FMath::FloorToInt32(MinCoord.X)),
+        FMath::Max(0, FMath::FloorToInt32(MinCoord.Y)),
+        FMath::Max(0, FMath::FloorToInt32(MinCoord.Z)));
+    FIntVector ChunkMax(
+        FMath::Min(ChunkDims.X - 1, FMath::FloorToInt32(MaxCoord.X)),
+        FMath::Min(ChunkDims.Y - 1, FMath::FloorToInt32(MaxCoord.Y)),
+        FMath::Min(ChunkDims.Z - 1, FMath::FloorToInt32(MaxCoord.Z)));
+
+    for (int32 Z = ChunkMin.Z; Z <= ChunkMax.Z; Z++)
+        for (int32 Y = ChunkMin.Y; Y <= ChunkMax.Y; Y++)
+            for (int32 X = ChunkMin.X; X <= ChunkMax.X; X++)
+                OutChunks.Add(FIntVector(X, Y, Z));
+}
+
+void FVoxelSurfaceMesher::GetChunkBrickRange(const FIntVector& ChunkCoord, FIntVector& OutBrickMin, FIntVector& OutBrickMax) const
+{
+    // 与 ExtractChunk 的格点窗口一致
+    FIntVector OwnMin = ChunkCoord * ChunkCells;
+    FIntVector OwnMax(
+        FMath::Min(OwnMin.X + ChunkCells, CellDims.X),
+        FMath::Min(OwnMin.Y + ChunkCells, CellDims.Y),
+        FMath::Min(OwnMin.Z + ChunkCells, CellDims.Z));
+    FIntVector WindowMin(FMath::Max(OwnMin.X - 1, 0), FMath::Max(OwnMin.Y - 1, 0), FMath::Max(OwnMin.Z - 1, 0));
+
+    const int32 BrickLattice = FMaVoxelData::BrickSize / Stride;
+    OutBrickMin = WindowMin / BrickLattice;
+    OutBrickMax = OwnMax / BrickLattice;
+}
+
+void FVoxelSurfaceMesher::ExtractChunk(const FMaVoxelData& Voxels, const FIntVector& ChunkCoord, FVoxelSurfaceChunk& Chunk) const
+{
+    Chunk = FVoxelSurfaceChunk();
+
+    // 本块拥有的单元 [OwnMin, OwnMax)；负方向多处理一层与前一分块共享的单元
+    FIntVector OwnMin = ChunkCoord * ChunkCells;
+    FIntVector OwnMax(
+        FMath::Min(OwnMin.X + ChunkCells, CellDims.X),
+        FMath::Min(OwnMin.Y + ChunkCells, CellDims.Y),
+        FMath::Min(OwnMin.Z + ChunkCells, CellDims.Z));
+    if (OwnMin.X >= OwnMax.X || OwnMin.Y >= OwnMax.Y || OwnMin.Z >= OwnMax.Z) return;
+
+    // 需要读取的格点窗口 [WindowMin, WindowMax]
+    FIntVector WindowMin(FMath::Max(OwnMin.X - 1, 0), FMath::Max(OwnMin.Y - 1, 0), FMath::Max(OwnMin.Z - 1, 0));
+    FIntVector WindowMax = OwnMax;
+    FIntVector WindowDims = WindowMax - WindowMin + FIntVector(1, 1, 1);
+    auto WindowIndex = [&WindowDims](int32 X, int32 Y, int32 Z)
+    {
+        return (Z * WindowDims.Y + Y) * WindowDims.X + X;
+    };
+
+    // 窗口覆盖的砖块范围，每个砖块记录格点的符号情况（1：有内部点，2：有外部点）
+    const int32 BrickLattice = FMaVoxelData::BrickSize / Stride;
+    FIntVector BrickMin = WindowMin / BrickLattice;
+    FIntVector BrickMax = WindowMax / BrickLattice;
+    FIntVector BrickSpan = BrickMax - BrickMin + FIntVector(1, 1, 1);
+    auto BrickFlagIndex = [&BrickSpan](int32 X, int32 Y, int32 Z)
+    {
+        return (Z * BrickSpan.Y + Y) * BrickSpan.X + X;
+    };
+
+    TArray<float> Values;
+    Values.SetNumUninitialized(WindowDims.X * WindowDims.Y * WindowDims.Z);
+    TArray<uint8> BrickFlags;
+    BrickFlags.SetNumZeroed(BrickSpan.X * BrickSpan.Y * BrickSpan.Z);
+
+    // 从砖块中读取格点值（量化格式先解码整个砖块）
+    float BrickScratch[FMaVoxelData::BrickVoxelCount];
+    for (int32 BZ = BrickMin.Z; BZ <= BrickMax.Z; BZ++)
+    {
+        for (int32 BY = BrickMin.Y; BY <= BrickMax.Y; BY++)
+        {
+            for (int32 BX = BrickMin.X; BX <= BrickMax.X; BX++)
+            {
+                const FVoxelBrickCell& Cell = Voxels.GetBrickCell(FIntVector(BX, BY, BZ));
+                const float* BrickVoxels = Voxels.ReadCell(FIntVector(BX, BY, BZ), BrickScratch);
+
+                FIntVector LatticeBase(BX * BrickLattice, BY * BrickLattice, BZ * BrickLattice);
+                int32 X0 = FMath::Max(LatticeBase.X, WindowMin.X), X1 = FMath::Min(LatticeBase.X + BrickLattice - 1, WindowMax.X);
+                int32 Y0 = FMath::Max(LatticeBase.Y, WindowMin.Y), Y1 = FMath::Min(LatticeBase.Y + BrickLattice - 1, WindowMax.Y);
+                int32 Z0 = FMath::Max(LatticeBase.Z, WindowMin.Z), Z1 = FMath::Min(LatticeBase.Z + BrickLattice - 1, WindowMax.Z);
+
+                uint8 Flags = 0;
+                for (int32 Z = Z0; Z <= Z1; Z++)
+                {
+                    for (int32 Y = Y0; Y <= Y1; Y++)
+                    {
+                        for (int32 X = X0; X <= X1; X++)
+                        {
+                            float Value = BrickVoxels
+                                ? BrickVoxels[FMaVoxelData::GetLocalVoxelIndex((X - LatticeBase.X) * Stride, (Y - LatticeBase.Y) * Stride, (Z - LatticeBase.Z) * Stride)]
+                                : Cell.UniformValue;
+                            Values[WindowIndex(X - WindowMin.X, Y - WindowMin.Y, Z - WindowMin.Z)] = Value;
+                            Flags |= (Value < 0.0f) ? 1 : 2;
+                        }
+                    }
+                }
+                BrickFlags[BrickFlagIndex(BX - BrickMin.X, BY - BrickMin.Y, BZ - BrickMin.Z)] = Flags;
+            }
+        }
+    }
+
+    // 每个单元对应的顶点（单元范围 [WindowMin, OwnMax)）
+    FIntVector CellSpan = OwnMax - WindowMin;
+    auto CellIndex = [&CellSpan](int32 X, int32 Y, int32 Z)
+    {
+        return (Z * CellSpan.Y + Y) * CellSpan.X + X;
+    };
+    TArray<int32> CellVertices;
+    CellVertices.Init(INDEX_NONE, CellSpan.X * CellSpan.Y * CellSpan.Z);
+    TArray<FIntVector> OwnSurfaceCells;
+
+    for (int32 BZ = BrickMin.Z; BZ <= BrickMax.Z; BZ++)
+    {
+        for (int32 BY = BrickMin.Y; BY <= BrickMax.Y; BY++)
+        {
+            for (int32 BX = BrickMin.X; BX <= BrickMax.X; BX++)
+            {
+                // 该砖块内单元的角点落在它和正方向相邻的砖块中，全部同号则整块跳过
+                uint8 Flags = 0;
+                for (int32 i = 0; i < 8; i++)
+                {
+                    int32 NX = BX - BrickMin.X + (i & 1);
+                    int32 NY = BY - BrickMin.Y + ((i >> 1) & 1);
+                    int32 NZ = BZ - BrickMin.Z + ((i >> 2) & 1);
+                    if (NX < BrickSpan.X && NY < BrickSpan.Y && NZ < BrickSpan.Z)
+                    {
+                        Flags |= BrickFlags[BrickFlagIndex(NX, NY, NZ)];
+                    }
+                }
+                if (Flags != 3) continue;
+
+                FIntVector LatticeBase(BX * BrickLattice, BY * BrickLattice, BZ * BrickLattice);
+                int32 X0 = FMath::Max(LatticeBase.X, WindowMin.X), X1 = FMath::Min(LatticeBase.X + BrickLattice, OwnMax.X) - 1;
+                int32 Y0 = FMath::Max(LatticeBase.Y, WindowMin.Y), Y1 = FMath::Min(LatticeBase.Y + BrickLattice, OwnMax.Y) - 1;
+                int32 Z0 = FMath::Max(LatticeBase.Z, WindowMin.Z), Z1 = FMath::Min(LatticeBase.Z + BrickLattice, OwnMax.Z) - 1;
+
+                for (int32 Z = Z0; Z <= Z1; Z++)
+                {
+                    for (int32 Y = Y0; Y <= Y1; Y++)
+                    {
+                        for (int32 X = X0; X <= X1; X++)
+                        {
+                            float Corners[8];
+                            int32 InsideMask = 0;
+                            for (int32 i = 0; i < 8; i++)
+                            {
+                                Corners[i] = Values[WindowIndex(X - WindowMin.X + (i & 1), Y - WindowMin.Y + ((i >> 1) & 1), Z - WindowMin.Z + ((i >> 2) & 1))];
+                                if (Corners[i] < 0.0f)
+                                {
+                                    InsideMask |= 1 << i;
+                                }
+                            }
+                            if (InsideMask == 0 || InsideMask == 0xFF) continue;
+
+                            // 顶点取单元内所有穿越等值面的边上交点的平均值
+                            FVector3d Sum = FVector3d::Zero();
+                            int32 Crossings = 0;
+                            for (int32 i = 0; i < 8; i++)
+                            {
+                                for (int32 Axis = 0; Axis < 3; Axis++)
+                                {
+                                    int32 Bit = 1 << Axis;
+                                    if (i & Bit) continue;
+                                    int32 j = i | Bit;
+                                    if (((InsideMask >> i) & 1) == ((InsideMask >> j) & 1)) continue;
+
+                                    double t = Corners[i] / (double)(Corners[i] - Corners[j]);
+                                    FVector3d Point((i & 1), ((i >> 1) & 1), ((i >> 2) & 1));
+                                    Point[Axis] += t;
+                                    Sum += Point;
+                                    Crossings++;
+                                }
+                            }
+                            FVector3d LatticePos = FVector3d(X, Y, Z) + Sum / Crossings;
+
+                            bool bOwnCell = X >= OwnMin.X && Y >= OwnMin.Y && Z >= OwnMin.Z;
+                            bool bSharedCell = !bOwnCell || X == OwnMax.X - 1 || Y == OwnMax.Y - 1 || Z == OwnMax.Z - 1;
+
+                            CellVertices[CellIndex(X - WindowMin.X, Y - WindowMin.Y, Z - WindowMin.Z)] = Chunk.Vertices.Add(Origin + LatticePos * CellSize);
+                            Chunk.VertexKeys.Add(((int64)Z * CellDims.Y + Y) * CellDims.X + X);
+                            Chunk.FixedVertices.Add(bSharedCell);
+                            if (bOwnCell)
+                            {
+                                OwnSurfaceCells.Add(FIntVector(X, Y, Z));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // 本块单元的最小角点出发的三条边如果穿越等值面，则连接共享该边的四个单元顶点
+    for (const FIntVector& Cell : OwnSurfaceCells)
+    {
+        float V0 = Values[WindowIndex(Cell.X - WindowMin.X, Cell.Y - WindowMin.Y, Cell.Z - WindowMin.Z)];
+        for (int32 Axis = 0; Axis < 3; Axis++)
+        {
+            int32 U = (Axis + 1) % 3;
+            int32 V = (Axis + 2) % 3;
+            if (Cell[U] == 0 || Cell[V] == 0) continue;
+
+            FIntVector Next = Cell;
+            Next[Axis] += 1;
+            float V1 = Values[WindowIndex(Next.X - WindowMin.X, Next.Y - WindowMin.Y, Next.Z - WindowMin.Z)];
+            if ((V0 < 0.0f) == (V1 < 0.0f)) continue;
+
+            FIntVector CellU = Cell, CellV = Cell, CellUV = Cell;
+            CellU[U] -= 1;
+            CellV[V] -= 1;
+            CellUV[U] -= 1;
+            CellUV[V] -= 1;
+
+            auto GetCellVertex = [&](const FIntVector& C)
+            {
+                return CellVertices[CellIndex(C.X - WindowMin.X, C.Y - WindowMin.Y, C.Z - WindowMin.Z)];
+            };
+            int32 A = GetCellVertex(CellUV);
+            int32 B = GetCellVertex(CellV);
+            int32 C = GetCellVertex(Cell);
+            int32 D = GetCellVertex(CellU);
+            if (A == INDEX_NONE || B == INDEX_NONE || C == INDEX_NONE || D == INDEX_NONE) continue;
+
+            // 法线朝向数值增大的方向（外部）
+            if (V0 < 0.0f)
+            {
+                Chunk.Triangles.Add(FIndex3i(A, C, B));
+                Chunk.Triangles.Add(FIndex3i(A, D, C));
+            }
+            else
+            {
+                Chunk.Triangles.Add(FIndex3i(A, B, C));
+                Chunk.Triangles.Add(FIndex3i(A, C, D));
+            }
+        }
+    }
+}
@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelToolSDF.h"
+
+#include "DynamicMesh/DynamicMeshAABBTree3.h"
+#include "Spatial/FastWinding.h"
+
+bool FVoxelToolSDF::Build(const FDynamicMesh3& ToolMesh, double InCellSize, double Padding, FProgressCancel* Progress)
+{
+    Values.Empty();
+    if (ToolMesh.TriangleCount() == 0 || InCellSize <= 0.0)
+    {
+        UE_LOG(LogTemp, Error, TEXT("FVoxelToolSDF::Build: Invalid tool mesh or cell size"));
+        return false;
+    }
+
+    double StartTime = FPlatformTime::Seconds();
+
+    MeshBounds = ToolMesh.GetBounds();
+    FVector3d Min = MeshBounds.Min - FVector3d(Padding);
+    FVector3d Size = MeshBounds.Max + FVector3d(Padding) - Min;
+
+    // 采样数过多时放大间距
+    CellSize = FMath::Max(InCellSize, Size.GetMax() / (MaxSamplesPerAxis - 1));
+    Dims = FIntVector(
+        FMath::CeilToInt32(Size.X / CellSize) + 1,
+        FMath::CeilToInt32(Size.Y / CellSize) + 1,
+        FMath::CeilToInt32(Size.Z / CellSize) + 1);
+    Bounds = FAxisAlignedBox3d(Min, Min + FVector3d(Dims.X - 1, Dims.Y - 1, Dims.Z - 1) * CellSize);
+
+    FDynamicMeshAABBTree3 Spatial(&ToolMesh);
+    TFastWindingTree<FDynamicMesh3> Winding(&Spatial);
+
+    Values.SetNumUninitialized(Dims.X * Dims.Y * Dims.Z);
+
+    // 并行处理Z轴
+    ParallelFor(Dims.Z, [&](int32 Z)
+    {
+        if (Progress && Progress->Cancelled()) return;
+
+        for (int32 Y = 0; Y < Dims.Y; Y++)
+        {
+            for (int32 X = 0; X < Dims.X; X++)
+            {
+                FVector3d Pos = Min + FVector3d(X, Y, Z) * CellSize;
+
+                double NearestDistSqr;
+                Spatial.FindNearestTriangle(Pos, NearestDistSqr);
+                double Distance = FMathd::Sqrt(NearestDistSqr);
+
+                // 内部为负，外部为正
+                Values[(Z * Dims.Y + Y) * Dims.X + X] = (float)(Winding.IsInside(Pos) ? -Distance : Distance);
+            }
+        }
+    });
+
+    if (Progress && Progress->Cancelled())
+    {
+        Values.Empty();
+        return false;
+    }
+
+    double EndTime = FPlatformTime::Seconds();
+    UE_LOG(LogTemp, Warning, TEXT("刀具距离场烘焙耗时: %.2f 毫秒, 采样网格=%s, 间距=%.3f"),
+        (EndTime - StartTime) * 1000.0, *Dims.ToString(), CellSize);
+    return true;
+}
+
+float FVoxelToolSDF::Sample(const FVector3d& LocalPos) const
+{
+    // 网格外的点先投影到网格边界
+    FVector3d Clamped(
+        FMath::Clamp(LocalPos.X, Bounds.Min.X, Bounds.Max.X),
+        FMath::Clamp(LocalPos.Y, Bounds.Min.Y, Bounds.Max.Y),
+        FMath::Clamp(LocalPos.Z, Bounds.Min.Z, Bounds.Max.Z));
+    double OutsideDistance = Distance(Clamped, LocalPos);
+
+    FVector3d Coord = (Clamped - Bounds.Min) / CellSize;
+    int32 X = FMath::Clamp(FMath::FloorToInt32(Coord.X), 0, Dims.X - 2);
+    int32 Y = FMath::Clamp(FMath::FloorToInt32(Coord.Y), 0, Dims.Y - 2);
+    int32 Z = FMath::Clamp(FMath::FloorToInt32(Coord.Z), 0, Dims.Z - 2);
+    float u = (float)FMath::Clamp(Coord.X - X, 0.0, 1.0);
+    float v = (float)FMath::Clamp(Coord.Y - Y, 0.0, 1.0);
+    float w = (float)FMath::Clamp(Coord.Z - Z, 0.0, 1.0);
+
+    const int32 StrideY = Dims.X;
+    const int32 StrideZ = Dims.X * Dims.Y;
+    const float* Base = Values.GetData() + (Z * Dims.Y + Y) * Dims.X + X;
+
+    float x00 = FMath::Lerp(Base[0], Base[1], u);
+    float x10 = FMath::Lerp(Base[StrideY], Base[StrideY + 1], u);
+    float x01 = FMath::Lerp(Base[StrideZ], Base[StrideZ + 1], u);
+    float x11 = FMath::Lerp(Base[StrideZ + StrideY], Base[StrideZ + StrideY + 1], u);
+
+    float y0 = FMath::Lerp(x00, x10, v);
+    float y1 = FMath::Lerp(x01, x11, v);
+
+    return FMath::Lerp(y0, y1, w) + (float)OutsideDistance;
+}
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelToolShape.h"
+
+using namespace UE::Geometry;
+
+double FVoxelToolShape::Evaluate(const FVector3d& LocalPos) const
+{
+    const FVector3d P = LocalPos - Center;
+
+    // 各形状均为闭式解，只用 Min/Max/Abs/Sqrt，没有数据相关分支
+    switch (Type)
+    {
+    case EVoxelToolShapeType::Sphere:
+        return P.Length() - Radius;
+
+    case EVoxelToolShapeType::Capsule:
+        {
+            double Z = P.Z - FMath::Clamp(P.Z, -(double)HalfHeight, (double)HalfHeight);
+            return FMath::Sqrt(P.X * P.X + P.Y * P.Y + Z * Z) - Radius;
+        }
+
+    case EVoxelToolShapeType::Cylinder:
+        {
+            // 圆角圆柱：CornerRadius 为 0 时即为平底圆柱
+            double Rounding = FMath::Min((double)CornerRadius, FMath::Min((double)Radius, (double)HalfHeight));
+            double DX = FMath::Sqrt(P.X * P.X + P.Y * P.Y) - Radius + Rounding;
+            double DZ = FMath::Abs(P.Z) - HalfHeight + Rounding;
+            double Outside = FMath::Sqrt(FMath::Square(FMath::Max(DX, 0.0)) + FMath::Square(FMath::Max(DZ, 0.0)));
+            return FMath::Min(FMath::Max(DX, DZ), 0.0) + Outside - Rounding;
+        }
+
+    case EVoxelToolShapeType::Box:
+        {
+            FVector3d Q(FMath::Abs(P.X) - BoxExtent.X, FMath::Abs(P.Y) - BoxExtent.Y, FMath::Abs(P.Z) - BoxExtent.Z);
+            FVector3d Outside(FMath::Max(Q.X, 0.0), FMath::Max(Q.Y, 0.0), FMath::Max(Q.Z, 0.0));
+            return Outside.Length() + FMath::Min(FMath::Max(Q.X, FMath::Max(Q.Y, Q.Z)), 0.0);
+        }
+
+    case EVoxelToolShapeType::Torus:
+        {
+            double Ring = FMath::Sqrt(P.X * P.X + P.Y * P.Y) - Radius;
+            return FMath::Sqrt(Ring * Ring + P.Z * P.Z) - CornerRadius;
+        }
+
+    default:
+        return TNumericLimits<double>::Max();
+    }
+}
+
+FAxisAlignedBox3d FVoxelToolShape::GetLocalBounds() const
+{
+    FVector3d Extent;
+    switch (Type)
+    {
+    case EVoxelToolShapeType::Sphere:
+        Extent = FVector3d(Radius);
+        break;
+    case EVoxelToolShapeType::Capsule:
+        Extent = FVector3d(Radius, Radius, HalfHeight + Radius);
+        break;
+    case EVoxelToolShapeType::Cylinder:
+        Extent = FVector3d(Radius, Radius, HalfHeight);
+        break;
+    case EVoxelToolShapeType::Box:
+        Extent = FVector3d(BoxExtent);
+        break;
+    case EVoxelToolShapeType::Torus:
+        Extent = FVector3d(Radius + CornerRadius, Radius + CornerRadius, CornerRadius);
+        break;
+    default:
+        return FAxisAlignedBox3d::Empty();
+    }
+    return FAxisAlignedBox3d(Center - Extent, Center + Extent);
+}
@@ -4,52 +4,231 @@
 
 #include "CoreMinimal.h"
 #include "DynamicMesh/DynamicMeshAABBTree3.h"
+#include "Util/ProgressCancel.h"
+#include "MaVoxelData.generated.h"
 
 using namespace UE::Geometry;
 
-// 八叉树节点
-struct PHYSICSTEST_API FOctreeNode
+// 砖块索引项：指向砖块池中的槽位，或表示一个只存常量值的均匀砖块
+struct PHYSICSTEST_API FVoxelBrickCell
 {
-	FAxisAlignedBox3d Bounds;
-	TArray<FOctreeNode> Children;
-	TArray<float> Voxels; // 叶子节点存储体素数据
-	int32 VoxelsPerSide = 0; // 每边体素数量
-	int32 Depth = 0;
-	bool bIsLeaf = true;
-	bool bIsEmpty = true; // 标记节点是否为空（优化用）
-	
-
-	void Subdivide(double MinVoxelSize);
-	bool ContainsPoint(const FVector3d& Point) const;
-	bool IntersectsBounds(const FAxisAlignedBox3d& OtherBounds) const;
+	// 细化网格中尚未被修改的砖块，体素值从父级网格插值得到
+	static constexpr int32 ParentPoolIndex = -2;
+
+	int32 PoolIndex = INDEX_NONE; // 砖块池槽位，INDEX_NONE 表示未分配（均匀砖块）
+	float UniformValue = 1.0f;    // 均匀砖块的常量值（正值为外部空区域，负值为内部实心区域）
+
+	bool IsAllocated() const { return PoolIndex >= 0; }
+	bool IsFromParent() const { return PoolIndex == ParentPoolIndex; }
+};
+
+// 体素化方法
+enum class EVoxelizeMethod : uint8
+{
+	MeshQuery,   // 逐采样点查询最近三角形并用快速绕数判定内外（适用于非封闭网格）
+	Rasterize    // 三角形光栅化窄带 + 快速扫描传播距离 + 扫描线奇偶判定内外（要求网格封闭）
+};
+
+// 砖块体素的存储格式
+UENUM(BlueprintType)
+enum class EVoxelStorageFormat : uint8
+{
+	Float32,    // 每个体素一个 float，保留完整距离
+	Int16,      // 距离截断到窄带内，按砖块缩放量化为 16 位
+	Int8        // 同上，量化为 8 位
 };
 
 // 体素数据容器
+// 采用稀疏砖块网格：固定大小的叶子砖块连续存放在一个砖块池中，
+// 通过按砖块坐标排列的稠密索引表做 O(1) 查找
 struct PHYSICSTEST_API FMaVoxelData
 {
+	// 每个砖块每边的体素数量
+	static constexpr int32 BrickSize = 8;
+	static constexpr int32 BrickVoxelCount = BrickSize * BrickSize * BrickSize;
+
+	// 构建时的任务粒度：不小于该尺寸（砖块数）的子树作为独立任务，窄带砖块每批采样的数量
+	static constexpr int32 ParallelNodeBricks = 4;
+	static constexpr int32 BuildBricksPerBatch = 2;
+
+	// 批量查询每块处理的采样数
+	static constexpr int32 SampleBatchSize = 256;
+
+	// 按需细化时相对父级网格的最大倍数
+	static constexpr int32 MaxRefineFactor = 8;
+
 	// 控制Voxel精度的参数
 	double MarchingCubeSize = 2.0f; // Marching Cubes的体素大小
-	int32 MaxOctreeDepth = 6; // 最大深度，控制精度
+	int32 MaxOctreeDepth = 6; // 最大深度，控制精度（砖块尺寸不超过 根尺寸/2^深度）
 	double MinVoxelSize = 0.5; // 最小体素大小
 
-	FOctreeNode OctreeRoot;
+	// 存储格式。量化格式下距离被截断到 ±QuantizeBandVoxels 个体素间距内，
+	// 每个砖块按自身的最大绝对值选取缩放，表面附近保留足够精度
+	EVoxelStorageFormat StorageFormat = EVoxelStorageFormat::Float32;
+	double QuantizeBandVoxels = 4.0;
+
+	// 砖块网格
+	FAxisAlignedBox3d Bounds;                       // 采样点覆盖的世界空间范围
+	double VoxelSize = 0.0;                         // 体素间距
+	FIntVector BrickDims = FIntVector::ZeroValue;   // 每轴砖块数量
+	TArray<FVoxelBrickCell> BrickTable;             // 砖块索引表（按砖块坐标线性排列）
+	TArray<uint8> BrickPool;                        // 所有已分配砖块的体素数据，连续存放（格式见 StorageFormat）
+	TArray<float> BrickScales;                      // 每个池槽位的量化步长（仅量化格式）
+	TArray<FIntVector> BrickCoords;                 // 每个池槽位对应的砖块坐标，空闲槽位为 FreeSlotCoord
+	TArray<int32> FreeBrickSlots;                   // 已释放、等待复用的池槽位
+
+	// 空闲槽位的砖块坐标标记
+	static const FIntVector FreeSlotCoord;
+
+	// 按需细化：父级为构建时的粗网格（只读，快照之间直接共享），本网格的体素间距为其 1/RefineFactor。
+	// 父级中已分配的砖块在这里先标记为继承父级，不占用砖块池，第一次被 UpdateRegion 修改时才插值展开
+	TSharedPtr<const FMaVoxelData, ESPMode::ThreadSafe> Parent;
+	int32 RefineFactor = 1;
+
+	// 清空数据。默认保留各数组的容量，重新构建时直接复用内存；bReleaseMemory 时归还给系统
+	void Reset(bool bReleaseMemory = false);
+	bool IsValid() const { return BrickTable.Num() > 0; }
+	bool IsRefined() const { return Parent.IsValid(); }
 
-	void Reset();
-	bool IsValid() const { return  !OctreeRoot.Bounds.IsEmpty(); }
-	
-	void BuildOctreeFromMesh(const FDynamicMesh3& Mesh, const FTransform& Transform);
+	// 以 InParent 为父级建立细化网格（覆盖相同范围，每轴砖块数为父级的 InRefineFactor 倍）。
+	// 父级的均匀砖块直接继承均匀值，其余砖块标记为继承父级
+	void InitializeRefined(TSharedPtr<const FMaVoxelData, ESPMode::ThreadSafe> InParent, int32 InRefineFactor);
+
+	// 从网格构建体素数据，Progress 用于报告进度和取消；取消时数据被清空并返回 false
+	bool BuildOctreeFromMesh(const FDynamicMesh3& Mesh, const FTransform& Transform, FProgressCancel* Progress = nullptr);
+	// 光栅化构建：不做逐点的网格查询，结果与 BuildOctreeFromMesh 在窄带内一致
+	bool BuildFromMeshRasterized(const FDynamicMesh3& Mesh, const FTransform& Transform, FProgressCancel* Progress = nullptr);
 	float GetValueAtPosition(const FVector3d& WorldPos) const;
-	void UpdateRegion(const FAxisAlignedBox3d& UpdateBounds, const TFunctionRef<float(const FVector3d&)>& UpdateFunction);
+	// 批量查询，结果与逐个调用 GetValueAtPosition 一致（浮点误差内）。
+	// 分块处理：每块内的采样按所在砖块分组，每个砖块只查表/解码一次，三线性插值以 SIMD 一次计算 4 个采样
+	void GetValuesAtPositions(TArrayView<const FVector3d> Positions, TArrayView<float> OutValues) const;
+	// 更新范围内的体素。受影响的砖块并行处理，UpdateFunction 会被多个线程同时调用，
+	// 每次处理一个砖块内落在范围中的全部采样点：参数为采样点坐标和当前值，在 Values 中原地写入新值；
+	// 返回值被修改的体素数量。
+	// 实心均匀砖块按常量值展开，被修改时才分配；空的均匀砖块只在 bIncludeEmptyBricks 时同样处理（用于添加材料）；
+	// 继承父级的砖块从父级插值展开，同样只有被修改时才分配
+	int64 UpdateRegion(const FAxisAlignedBox3d& UpdateBounds, const TFunctionRef<void(TArrayView<const FVector3d>, TArrayView<float>)>& UpdateFunction,
+					   bool bIncludeEmptyBricks = false);
+	// 复制 Source 在砖块范围 [BrickMin, BrickMax] 内的数据，作为只读快照。
+	// 范围外的索引表条目可能是之前某次快照的旧值，不能用来读取体素；
+	// 重复调用时复用已有内存，只改写上次分配过的条目和本次范围内的条目，开销与范围大小成正比
+	void CopyRegionFrom(const FMaVoxelData& Source, const FIntVector& BrickMin, const FIntVector& BrickMax);
 
 	// 调试
 	void DebugLogOctreeStats() const;
 
 	// 获取用于Marching Cubes的边界
-	FAxisAlignedBox3d GetOctreeBounds() const { return OctreeRoot.Bounds; }
+	FAxisAlignedBox3d GetOctreeBounds() const { return Bounds; }
+
+	// 砖块访问
+	FIntVector GetSampleDims() const { return BrickDims * BrickSize; }
+	int32 GetNumAllocatedBricks() const { return BrickCoords.Num() - FreeBrickSlots.Num(); }
+	int32 GetNumPoolSlots() const { return BrickCoords.Num(); }
+	bool IsPoolSlotInUse(int32 PoolIndex) const { return BrickCoords[PoolIndex] != FreeSlotCoord; }
+	// 为接下来将要分配的 NumBricks 个砖块预留池容量（优先复用空闲槽位），避免逐个分配时反复扩容
+	void ReserveBricks(int32 NumBricks);
+	// 释放砖块的池槽位供之后复用，砖块变为值为 UniformValue 的均匀砖块
+	void FreeBrick(const FIntVector& BrickCoord, float UniformValue);
+	// 把 Region 内已经整体同号、且全部距表面至少 BandVoxels 个体素间距的砖块收回为均匀砖块，
+	// 均匀值取最靠近表面的值（与构建时一致）。表面网格不受影响。返回收回的砖块数
+	int32 CollapseUniformBricks(const FAxisAlignedBox3d& Region, double BandVoxels);
+	// 把砖块范围 [KeepMin, KeepMax] 以外的全部砖块直接在索引表中置为值不小于 OutsideValue 的空均匀砖块，
+	// 不展开任何砖块（求交时刀具范围外的材料整体清除）。返回原先含有材料、表面因此改变的砖块的包围盒
+	FAxisAlignedBox3d ClearBricksOutside(const FIntVector& KeepMin, const FIntVector& KeepMax, float OutsideValue);
+	// 空闲槽位超过 MinFreeFraction 时整理砖块池：把末尾的砖块移入空闲槽位并缩小各数组，真正归还内存。
+	// 返回移动的砖块数
+	int32 CompactPool(float MinFreeFraction = 0.25f);
+	bool IsValidBrickCoord(const FIntVector& BrickCoord) const
+	{
+		return BrickCoord.X >= 0 && BrickCoord.Y >= 0 && BrickCoord.Z >= 0 &&
+			BrickCoord.X < BrickDims.X && BrickCoord.Y < BrickDims.Y && BrickCoord.Z < BrickDims.Z;
+	}
+	int32 GetBrickLinearIndex(const FIntVector& BrickCoord) const
+	{
+		return (BrickCoord.Z * BrickDims.Y + BrickCoord.Y) * BrickDims.X + BrickCoord.X;
+	}
+	const FVoxelBrickCell& GetBrickCell(const FIntVector& BrickCoord) const { return BrickTable[GetBrickLinearIndex(BrickCoord)]; }
+	FAxisAlignedBox3d GetBrickBounds(const FIntVector& BrickCoord) const;
+	// 与 Region 相交的砖块范围（裁剪到网格内，不相交时 OutMin 的某一轴大于 OutMax）
+	void GetBrickRange(const FAxisAlignedBox3d& Region, FIntVector& OutMin, FIntVector& OutMax) const;
+
+	bool IsQuantized() const { return StorageFormat != EVoxelStorageFormat::Float32; }
+	int32 GetBytesPerVoxel() const
+	{
+		return StorageFormat == EVoxelStorageFormat::Int8 ? 1 : (StorageFormat == EVoxelStorageFormat::Int16 ? 2 : 4);
+	}
+	int64 GetBrickStride() const { return (int64)BrickVoxelCount * GetBytesPerVoxel(); }
+
+	// float 格式下直接访问砖块数据
+	const float* GetBrickVoxels(int32 PoolIndex) const { check(!IsQuantized()); return reinterpret_cast<const float*>(BrickPool.GetData() + PoolIndex * GetBrickStride()); }
+	float* GetBrickVoxels(int32 PoolIndex) { check(!IsQuantized()); return reinterpret_cast<float*>(BrickPool.GetData() + PoolIndex * GetBrickStride()); }
+	// 读取整个砖块：float 格式直接返回池中的数据，量化格式解码到 Scratch（BrickVoxelCount 个）后返回 Scratch
+	const float* ReadBrick(int32 PoolIndex, float* Scratch) const;
+	// 写入整个砖块，量化格式下重新计算该砖块的缩放
+	void WriteBrick(int32 PoolIndex, const float* Values);
+	// 读取单个体素
+	float GetBrickValue(int32 PoolIndex, int32 LocalIndex) const;
+	// 按砖块坐标读取整个砖块：已分配的同 ReadBrick，继承父级的插值到 Scratch 后返回 Scratch，均匀砖块返回 nullptr
+	const float* ReadCell(const FIntVector& BrickCoord, float* Scratch) const;
+	static int32 GetLocalVoxelIndex(int32 X, int32 Y, int32 Z) { return (Z * BrickSize + Y) * BrickSize + X; }
+
+	// 全局采样点（体素网格坐标）的值与位置
+	float GetSample(int32 X, int32 Y, int32 Z) const;
+	FVector3d GetSamplePosition(int32 X, int32 Y, int32 Z) const { return Bounds.Min + FVector3d(X, Y, Z) * VoxelSize; }
 
 private:
 	// 内部辅助方法
-	float CalculateDistanceToMesh(const FDynamicMeshAABBTree3& Spatial, 
+	void InitializeBrickGrid(const FAxisAlignedBox3d& WorldBounds);
+	// 分配砖块并写入 Values（为空时以均匀值填充）
+	int32 AllocateBrick(const FIntVector& BrickCoord, const float* Values = nullptr);
+
+	// 从父级网格插值得到砖块的全部体素
+	void ResampleFromParent(const FIntVector& BrickCoord, float* OutValues) const;
+	// 细网格最末一层采样点略超出父级范围，按父级边界截取
+	FVector3d ClampToParentBounds(const FVector3d& Pos) const
+	{
+		return FVector3d(
+			FMath::Clamp(Pos.X, Parent->Bounds.Min.X, Parent->Bounds.Max.X),
+			FMath::Clamp(Pos.Y, Parent->Bounds.Min.Y, Parent->Bounds.Max.Y),
+			FMath::Clamp(Pos.Z, Parent->Bounds.Min.Z, Parent->Bounds.Max.Z));
+	}
+
+	// 按到表面的距离自适应构建：远离表面的节点整体存为常量，收集窄带内需要逐体素采样的砖块；每个节点检查取消
+	void ClassifyBrickNode(const FDynamicMeshAABBTree3& Spatial, TFastWindingTree<FDynamicMesh3>& Winding,
+						   const FIntVector& NodeMin, int32 NodeBricks, double BandWidth, TArray<FIntVector>& OutBandBricks, FProgressCancel* Progress);
+	// 逐体素采样一个砖块，返回是否落在窄带内（线程安全）
+	bool SampleBrick(const FDynamicMeshAABBTree3& Spatial, TFastWindingTree<FDynamicMesh3>& Winding,
+					 const FIntVector& BrickCoord, double BandWidth, float* OutValues) const;
+
+	float CalculateDistanceToMesh(const FDynamicMeshAABBTree3& Spatial,
 								TFastWindingTree<FDynamicMesh3>& Winding,
 								const FVector3d& Pos) const;
 };
+
+// 带缓存的体素读取器
+// 记住最近访问的砖块（量化格式或继承父级时同时缓存整块的解码 / 插值结果），空间上连续的采样大多落在同一砖块内，
+// 可以跳过查表和解码。结果与 FMaVoxelData 的同名查询一致。不是线程安全的，每个线程各用一个
+struct PHYSICSTEST_API FMaVoxelAccessor
+{
+	explicit FMaVoxelAccessor(const FMaVoxelData& InVoxels) : Voxels(InVoxels) {}
+
+	// 体素数据被修改后需要清除缓存
+	void Invalidate() { CachedBrick = FIntVector(INDEX_NONE); }
+
+	float GetSample(int32 X, int32 Y, int32 Z);
+	// 单元 (X, Y, Z) 的 8 个角点（按 X 最快、Z 最慢排列）
+	void GetCellCorners(int32 X, int32 Y, int32 Z, float OutCorners[8]);
+	float GetValueAtPosition(const FVector3d& Pos);
+	// 批量查询，按顺序处理，输入越连贯命中率越高
+	void GetValuesAtPositions(TArrayView<const FVector3d> Positions, TArrayView<float> OutValues);
+
+private:
+	// 切换到指定砖块，返回其体素（均匀砖块返回 nullptr，值在 CachedUniform 中）
+	const float* SelectBrick(int32 BX, int32 BY, int32 BZ);
+
+	const FMaVoxelData& Voxels;
+	FIntVector CachedBrick = FIntVector(INDEX_NONE);
+	const float* CachedValues = nullptr;
+	float CachedUniform = 1.0f;
+	float DecodeScratch[FMaVoxelData::BrickVoxelCount];
+};
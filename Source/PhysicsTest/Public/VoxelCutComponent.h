@@ -7,19 +7,15 @@
 #include "DynamicMesh/DynamicMesh3.h"
 #include "VoxelCutMeshOp.h"
 #include "Components/DynamicMeshComponent.h"
+#include "HAL/ThreadSafeBool.h"
 #include "VoxelCutComponent.generated.h"
 
 using namespace UE::Geometry;
 
-// 切削状态枚举
-UENUM()
-enum class ECutState : uint8
-{
-	Idle,           // 空闲状态
-	RequestPending, // 有切削请求待处理
-	Processing,     // 正在处理切削
-	Completed       // 切削完成，等待下一帧更新
-};
+class UVoxelCutSubsystem;
+
+// 切削系统后台初始化完成事件
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnVoxelCutSystemInitialized, bool, bSuccess);
 
 UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
 class PHYSICSTEST_API UVoxelCutComponent : public UActorComponent
@@ -63,6 +59,11 @@ public:
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
 	float MinVoxelSize = 0.5f;
+
+	// 切削精度：小于构建精度时，只有刀具实际加工到的砖块才细化到该体素间距；
+	// 结果网格的单元尺寸同时取该值与 MarchingCubeSize 中较小者，整个表面的三角形随之加密（0 表示不细化）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut", meta = (ClampMin = "0"))
+	float CutVoxelSize = 0.0f;
     
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
 	float SmoothingStrength = 0.5f;
@@ -76,21 +77,99 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
 	float UpdateThreshold = 1.0f;
 
+	// 连续扫掠切削：每次切削从上一次切削的位姿开始扫掠（处理期间积累的中间位姿总会被依次扫掠）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	bool bContinuousSweep = true;
+
+	// 使用光栅化体素化（更快，要求目标网格封闭；关闭时逐采样点查询网格）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	bool bFastVoxelization = false;
+
+	// 将体素化结果缓存到磁盘（Saved/VoxelCache），目标网格和精度参数不变时下次启动直接加载，默认关闭
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	bool bCacheVoxelData = false;
+
+	// 体素存储格式：量化格式把窄带距离压缩为 16/8 位，内存降为 1/2 或 1/4
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	EVoxelStorageFormat VoxelStorageFormat = EVoxelStorageFormat::Float32;
+
+	// 每次切削后回收已整体远离表面的砖块并整理砖块池，内存随剩余表面而变化
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	bool bCollapseUniformBricks = true;
+
+	// 按网格分块拆分渲染分段，每次切削只重新上传被修改的分段（目标网格组件本身会被隐藏）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	bool bUseRenderSections = true;
+
+	// 刀具与目标的布尔运算，在请求切削时读取，可以逐次切换（切除、堆积、求交、平滑变体）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	EVoxelCSGOperation CutOperation = EVoxelCSGOperation::Subtract;
+
+	// 平滑运算的过渡宽度（世界单位）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut", meta = (ClampMin = "0"))
+	float CSGSmoothness = 2.0f;
+
+	// 参数化刀具（类型为 Mesh 时使用刀具网格）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	FVoxelToolShape ToolShape;
+
+	// 交给 UVoxelCutSubsystem 统一调度：刀具与目标包围盒重叠时才产生切削请求，后台任务与场景中
+	// 其他切削目标一起按优先级分批提交（在 BeginPlay 时读取；关闭时组件自行 Tick 并直接提交到线程池）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	bool bUseCutScheduler = true;
+
 	// 切削状态
 	UFUNCTION(BlueprintCallable, Category = "Voxel Cut")
 	bool IsCutting() const { return bIsCutting; }
 	
-	// 获取切削结果网格
+	// 获取切削结果网格（启用渲染分段时，切削后的表面由挂在其下的分段组件显示）
 	UFUNCTION(BlueprintCallable, Category = "Voxel Cut")
 	UDynamicMeshComponent* GetResultMesh() const { return TargetMeshComponent; }
 
-	// 初始化切削系统
+	UFUNCTION(BlueprintCallable, Category = "Voxel Cut")
+	UDynamicMeshComponent* GetCutToolMesh() const { return CutToolMeshComponent; }
+
+	// 宽相位：刀具包围盒是否与目标包围盒（按切削可能影响的范围扩展）重叠
+	bool IsToolNearTarget() const;
+	// 刀具包围盒到目标包围盒的距离（重叠时为 0）
+	double GetToolDistanceToTarget() const;
+	// 目标的世界空间包围盒：初始化后取体素网格的范围（堆积的材料不会超出），之前取目标网格组件的包围盒
+	FBox GetTargetWorldBounds() const;
+
+	// 采样刀具位姿、产生切削请求并推进流水线（由 TickComponent 或调度子系统每帧调用）
+	// 刀具不在目标附近时不产生请求，重新靠近时从目标外的最后一个位姿开始新的一段扫掠
+	void TickCut(bool bToolNearTarget);
+
+	// 比较参数化刀具与网格刀具的距离计算耗时和误差
+	UFUNCTION(BlueprintCallable, Category = "Voxel Cut")
+	void BenchmarkToolShape(int32 NumSamples = 100000);
+
+	// 比较体素数据的逐点查询与批量查询耗时
+	UFUNCTION(BlueprintCallable, Category = "Voxel Cut")
+	void BenchmarkVoxelSampling(int32 NumSamples = 100000);
+
+	// 初始化切削系统（在后台线程体素化，完成时触发 OnCutSystemInitialized；
+	// 完成前的切削请求会排队，初始化成功后再处理）
 	void InitializeCutSystem();
+
+	// 初始化完成事件
+	UPROPERTY(BlueprintAssignable, Category = "Voxel Cut")
+	FOnVoxelCutSystemInitialized OnCutSystemInitialized;
+
+	// 初始化状态与进度（0 ~ 1）
+	UFUNCTION(BlueprintCallable, Category = "Voxel Cut")
+	bool IsCutSystemInitialized() const { return bSystemInitialized; }
+
+	UFUNCTION(BlueprintCallable, Category = "Voxel Cut")
+	float GetInitializationProgress() const;
 	
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
+	// 取消未完成的初始化
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	
 
 public:
@@ -108,20 +187,51 @@ private:
 	UPROPERTY()
 	UDynamicMeshComponent* CutToolMeshComponent;
 
-	// 可重用的切削操作器
-	TSharedPtr<FVoxelCutMeshOp> CutOp;
+	// 渲染分段组件（按网格分块索引），挂在目标网格组件下
+	UPROPERTY()
+	TMap<int32, UDynamicMeshComponent*> SectionComponents;
+
+	// 可重用的切削操作器（异步任务持有共享引用，组件销毁后任务仍可安全结束）
+	TSharedPtr<FVoxelCutMeshOp, ESPMode::ThreadSafe> CutOp;
+
+	// 负责调度本组件的子系统（未使用调度器时为空）
+	TWeakObjectPtr<UVoxelCutSubsystem> CutScheduler;
+
+	// 提交后台任务：交给调度子系统排队，或直接进入线程池
+	void DispatchJob(TUniqueFunction<void()> Job);
 	
 	// 状态管理
-	ECutState CutState;
 	std::atomic<bool> bIsCutting;      // 用户是否在切削模式
+
+	// 切削流水线：阶段一（体素更新）与阶段二（网格生成）各自最多一个任务，
+	// 阶段一处理请求 N+1 时阶段二可以同时为请求 N 生成网格
+	bool bVoxelStageBusy = false;
+	bool bMeshStageBusy = false;
+	FVoxelMeshSnapshot PendingSnapshot;    // 阶段一已完成、等待阶段二的快照（最多一个）
     
 	// 工具位置跟踪
 	FVector LastToolPosition;
 	FRotator LastToolRotation;
 	float DistanceSinceLastUpdate;
+
+	// 宽相位状态：刀具离开目标后只记录最近的位姿
+	bool bToolWasNearTarget = false;
+	bool bHasToolOutsidePose = false;
+	FTransform ToolOutsidePose;
     
-	// 当前请求的数据
-	FTransform CurrentToolTransform;
+	// 自上次提交切削以来请求的刀具位姿，下一次阶段一把运算相同的连续位姿合并为一次扫掠
+	struct FPendingCutPose
+	{
+		FTransform Transform;
+		EVoxelCSGOperation Operation;
+		float Smoothness;
+		bool bNewStroke;    // 开始新的一段行程，不与之前的位姿连成扫掠
+	};
+	TArray<FPendingCutPose> PendingToolPath;
+
+	// 上一次提交切削时的刀具位姿（扫掠起点）
+	FTransform LastCutToolTransform;
+	bool bHasLastCutToolTransform = false;
 	TSharedPtr<FDynamicMesh3> CurrentToolMesh;
     
 	// 线程同步
@@ -130,21 +240,45 @@ private:
 
 
 	bool bSystemInitialized = false;
+	bool bInitializing = false;
+
+	// 体素网格在目标局部空间的范围，初始化完成时记录；启用渲染分段时目标网格组件不再更新，不能用它的包围盒
+	FBox VoxelLocalBounds = FBox(ForceInit);
+
+	// 后台初始化的进度与取消标记
+	TSharedPtr<FProgressCancel, ESPMode::ThreadSafe> InitProgress;
+	TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe> InitCancelRequested;
+
+	// 初始化完成回调（主线程）
+	void OnInitializationComplete(bool bSuccess);
     
 	// 检查是否需要更新切削
 	bool NeedsCutUpdate(const FTransform& InCurrentToolTransform);
     
-	// 状态机处理
+	// 推进切削流水线
 	void UpdateStateMachine();
     
 	// 请求切削
-	void RequestCut(const FTransform& ToolTransform);
+	void RequestCut(const FTransform& ToolTransform, bool bNewStroke = false);
+
+	// 刀具的世界空间包围盒（参数化刀具按形状计算）
+	FBox GetToolWorldBounds() const;
     
-	// 开始异步切削
+	// 开始异步切削（阶段一）
 	void StartAsyncCut();
+
+	// 开始异步网格生成（阶段二）
+	void StartAsyncMesh();
+
+	// 阶段一完成回调
+	void OnVoxelStageComplete(FVoxelMeshSnapshot&& Snapshot, bool bSuccess);
     
-	// 切削完成回调
-	void OnCutComplete(FDynamicMesh3* ResultMesh);
+	// 切削完成回调（阶段二完成），接管结果网格或分段网格的所有权
+	void OnCutComplete(TUniquePtr<FDynamicMesh3> ResultMesh, TArray<FVoxelMeshSection> Sections);
+
+	// 更新渲染分段
+	void ApplySections(TArray<FVoxelMeshSection>& Sections);
+	UDynamicMeshComponent* GetOrCreateSectionComponent(int32 ChunkIndex);
     
 	// 复制工具网格（轻量级操作）
 	TSharedPtr<FDynamicMesh3> CopyToolMesh();
@@ -163,10 +297,9 @@ private:
 	
 	void VisualizeOctreeNode();
 
-	void VisualizeOctreeNodeRecursive(const FOctreeNode& Node, int32 Depth);
+	void VisualizeBrick(const FMaVoxelData& VoxelData, const FIntVector& BrickCoord);
 
 	void ClearOctreeVisualization();
 
 	void PrintOctreeDetails();
-	void PrintOctreeNodeRecursive(const FOctreeNode& Node, int32 Depth, int32& NodeCount, int32& LeafCount, int32& TotalVoxels);
 };
@@ -6,11 +6,31 @@
 #include "ModelingOperators.h"
 #include "BaseOps/VoxelBaseOp.h"
 #include "MaVoxelData.h"
+#include "VoxelSurfaceMesher.h"
+#include "VoxelToolSDF.h"
+#include "VoxelToolShape.h"
 
 namespace UE
 {
 	namespace Geometry
 	{		
+		// 流水线中由体素更新阶段交给网格生成阶段的数据
+		struct PHYSICSTEST_API FVoxelMeshSnapshot
+		{
+			TSharedPtr<FMaVoxelData, ESPMode::ThreadSafe> Voxels;  // 受影响分块所需砖块的体素副本
+			TArray<FIntVector> DirtyChunks;                        // 需要重新提取的分块
+			bool bRebuildAll = false;                              // 分块缓存需要整体重建
+
+			bool IsValid() const { return Voxels.IsValid(); }
+		};
+
+		// 按网格分块划分的渲染分段（目标局部空间）
+		struct PHYSICSTEST_API FVoxelMeshSection
+		{
+			int32 ChunkIndex = INDEX_NONE;
+			TUniquePtr<FDynamicMesh3> Mesh;   // 三角形为空表示该分块已没有表面
+		};
+
 		class PHYSICSTEST_API FVoxelCutMeshOp  : public FVoxelBaseOp
 		{
 		public:
@@ -20,26 +40,50 @@ namespace UE
 			TSharedPtr<FDynamicMesh3, ESPMode::ThreadSafe> TargetMesh;
 			TSharedPtr<const FDynamicMesh3, ESPMode::ThreadSafe> CutToolMesh;
     
-			// 变换矩阵
+			// 目标的世界变换。体素数据和结果网格都在目标局部空间，目标移动不需要重新体素化；
+			// 这里只用它的缩放把世界单位的精度参数换算到局部空间
 			FTransform TargetTransform;
+			// 刀具位姿（相对于目标局部空间）
 			FTransform CutToolTransform;
+
+			// 扫掠切削：上一次切削之后刀具经过的位姿（目标局部空间，按时间顺序，不含 CutToolTransform）
+			// 切削会去除沿 SweepWaypoints -> CutToolTransform 扫过的全部体积；为空时只在当前位姿切削
+			TArray<FTransform> SweepWaypoints;
     
 			// 持久化体素数据（输入/输出）
 			TSharedPtr<FMaVoxelData> PersistentVoxelData;
+
+			// 参数化刀具（非 Mesh 类型时直接使用闭式距离，不需要刀具网格）
+			FVoxelToolShape ToolShape;
+
+			// 刀具局部空间距离场（可选，未烘焙时回退到逐体素的网格查询）
+			TSharedPtr<FVoxelToolSDF, ESPMode::ThreadSafe> ToolSDF;
     
 			// 切削参数
+			EVoxelCSGOperation CutOperation = EVoxelCSGOperation::Subtract;   // 刀具与目标的布尔运算
+			double CSGSmoothness = 0.0;      // 平滑运算的过渡宽度（世界单位）
 			double CutOffset = 0.0;
 			bool bFillCutHole = true;
 			bool bKeepBothParts = false;
 			double MarchingCubeSize = 2.0;
 			int32 MaxOctreeDepth = 6;
 			double MinVoxelSize = 0.5;			
+			double CutVoxelSize = 0.0;       // 切削精度：小于构建得到的体素间距时，切削到的砖块按需细化到该精度，网格单元也不大于该值；0 表示不细化
 			bool bSmoothCutEdges = true;
 			int32 SmoothingIteration = 0;
 			double SmoothingStrength = 0.6;
     
 			// 增量更新选项
 			int32 UpdateMargin = 2;          // 更新边界扩展（体素单位）
+			int32 MeshChunkBricks = 4;       // 网格分块每边的砖块数
+			double SweepStepSize = 0.0;      // 扫掠插值位姿的最大间距，0 表示使用体素间距
+			int32 MaxSweepSteps = 128;       // 单次切削最多插值的位姿数量
+			bool bOutputSections = false;    // 只输出被修改分块的分段网格，不再合并整体网格
+			EVoxelizeMethod VoxelizeMethod = EVoxelizeMethod::MeshQuery;   // 目标网格体素化方法
+			EVoxelStorageFormat VoxelStorageFormat = EVoxelStorageFormat::Float32;   // 砖块体素存储格式
+			bool bUseVoxelCache = false;     // 体素化结果按输入哈希缓存到磁盘（Saved/VoxelCache）
+			bool bCollapseUniformBricks = true;   // 切削后把整体远离表面的砖块收回为均匀砖块并整理砖块池
+			double CollapseBandVoxels = 2.0;      // 收回阈值：砖块内全部体素距表面至少这么多个体素间距
 
 			void SetTransform(const FTransformSRT3d& Transform);
 
@@ -48,22 +92,48 @@ namespace UE
 			// 初始化体素数据（首次使用）
 			bool InitializeVoxelData(FProgressCancel* Progress);
     
+			// 烘焙刀具距离场（需在体素数据初始化后调用，以匹配体素精度）
+			bool InitializeToolSDF(FProgressCancel* Progress);
+    
+			// 比较参数化刀具、烘焙距离场与网格查询三种距离计算的耗时和误差
+			void BenchmarkToolDistance(int32 NumSamples) const;
+			// 比较逐点查询、缓存读取器与批量查询三种体素采样方式的耗时
+			void BenchmarkVoxelSampling(int32 NumSamples) const;
+    
 			// 增量切削（基于现有体素数据）
 			bool IncrementalCut(FProgressCancel* Progress);
 
+			// 流水线阶段一：切削体素，并为受影响的分块拍下体素快照
+			// 快照在两个缓冲区之间轮换，调用方需保证同一时刻最多有一个快照在等待或正在被阶段二读取
+			bool UpdateVoxelsStage(FVoxelMeshSnapshot& OutSnapshot, FProgressCancel* Progress);
+
+			// 流水线阶段二：从快照重新提取分块并生成 ResultMesh，可与下一次阶段一同时运行
+			void GenerateMeshStage(const FVoxelMeshSnapshot& Snapshot, FProgressCancel* Progress);
+
 			FDynamicMesh3* GetResultMesh() const
 			{
 				return ResultMesh.Get();
 			}
 
+			// 结果缓冲环：网格生成时从环中取一个缓冲区，只在其上重放它上次写入之后被修改的分块，得到 ResultMesh；
+			// 调用方用 ExtractResult() 取走所有权，与组件内的网格交换后归还。生成与交接都不复制整个网格，
+			// 只有内容未知的缓冲区（例如换出的原始目标网格）第一次使用时整体重建
+			// bSwappedIn 为 true 表示结果已与调用方显示的网格交换，归还的缓冲区里是之前显示的网格
+			void ReleaseResultBuffer(TUniquePtr<FDynamicMesh3> Buffer, bool bSwappedIn);
+
+			// 取走本次生成的分段网格（bOutputSections 为 true 时有效）
+			TArray<FVoxelMeshSection> ExtractSections() { return MoveTemp(ResultSections); }
+
 		protected:
 			// 体素化方法
 			bool VoxelizeMesh(const FDynamicMesh3& Mesh, const FTransform& Transform, 
 							 FMaVoxelData& VoxelData, FProgressCancel* Progress);
     
 			// 局部更新：只更新受刀具影响的区域
-			void UpdateLocalRegion(FMaVoxelData& TargetVoxels, const FDynamicMesh3& ToolMesh, 
-								  const FTransform& ToolTransform, FProgressCancel* Progress);
+			void UpdateLocalRegion(FMaVoxelData& TargetVoxels, const FDynamicMesh3* ToolMesh, FProgressCancel* Progress);
+    
+			// 沿扫掠路径插值刀具位姿
+			void BuildSweepPoses(const FAxisAlignedBox3d& LocalToolBounds, double StepSize, TArray<FTransform>& OutPoses) const;
     
 			// 网格生成
 			void ConvertVoxelsToMesh(const FMaVoxelData& Voxels, FProgressCancel* Progress);
@@ -72,8 +142,72 @@ namespace UE
 			// 内部状态
 			bool bVoxelDataInitialized = false;
 
-			// 平滑模型
-			void SmoothGeneratedMesh(FDynamicMesh3& Mesh, int32 Iterations);
+			// 网格分块缓存：每块保存已提取、平滑的表面，只有被切削影响的分块才重新提取
+			FVoxelSurfaceMesher SurfaceMesher;
+			TArray<FVoxelSurfaceChunk> MeshChunks;
+			bool bMeshChunksValid = false;
+
+			// 持久的合并网格：每次只替换被修改分块的顶点和三角形，接缝顶点按单元编号引用计数焊接
+			struct FMergedChunk
+			{
+				TArray<int32> VertexIDs;        // 分块顶点在合并网格中的编号
+				TArray<int64> SeamKeys;         // 接缝顶点的单元编号，非接缝顶点为 INDEX_NONE
+				TArray<FVector3d> NormalSums;   // 该分块贡献的法线和，移除时扣除
+				TArray<int32> TriangleIDs;
+			};
+			struct FMergedSeamVertex
+			{
+				int32 VertexID = INDEX_NONE;
+				int32 RefCount = 0;
+			};
+			// 每个结果缓冲区的内容各自对应一份合并状态。交出的网格与调用方显示的网格交换后回到缓冲环，
+			// 两份状态轮流使用：再次写入某个缓冲区时，只重放它上次写入之后被修改过的分块
+			struct FMergedMeshState
+			{
+				TArray<FMergedChunk> Chunks;
+				TMap<int64, FMergedSeamVertex> SeamVertices;
+				TArray<FVector3d> NormalSums;   // 按合并网格顶点编号
+				TSet<int32> PendingChunks;      // 该缓冲区写入之后又被修改、尚未重放的分块
+				bool bValid = false;
+			};
+			FMergedMeshState MergedStates[2];
+
+			// 自上次生成网格以来被修改的体素范围
+			FAxisAlignedBox3d DirtyBounds = FAxisAlignedBox3d::Empty();
+
+			// 阶段一 / 阶段二交替使用的体素快照缓冲区
+			TSharedPtr<FMaVoxelData, ESPMode::ThreadSafe> SnapshotBuffers[2];
+			int32 NextSnapshotBuffer = 0;
+
+			// 本次生成的分段网格
+			TArray<FVoxelMeshSection> ResultSections;
+
+			// 结果缓冲环，阶段二与游戏线程之间传递；每个缓冲区记录其内容对应的合并状态（INDEX_NONE 表示未知）
+			struct FResultBuffer
+			{
+				TUniquePtr<FDynamicMesh3> Mesh;
+				int32 State = INDEX_NONE;
+			};
+			static constexpr int32 MaxResultBuffers = 2;
+			TArray<FResultBuffer> FreeResultBuffers;
+			int32 ResultState = INDEX_NONE;            // 当前 ResultMesh 对应的合并状态
+			int32 HandedOutResultState = INDEX_NONE;   // 最近一次交出的结果对应的合并状态
+			int32 DisplayedResultState = INDEX_NONE;   // 调用方正在显示的网格对应的合并状态
+			FCriticalSection ResultBufferLock;
+			TUniquePtr<FDynamicMesh3> AcquireResultBuffer(int32& OutState);
+			int32 ClaimResultState();
+
+			// 根据脏区域确定需要重新提取的分块（首次调用时初始化提取器）
+			void CollectDirtyChunks(const FMaVoxelData& Voxels, TArray<FIntVector>& OutChunks, bool& bOutRebuildAll);
+			void GenerateMeshFromChunks(const FMaVoxelData& Voxels, const TArray<FIntVector>& DirtyChunks, bool bRebuildAll, FProgressCancel* Progress);
+
+			// 分块网格生成
+			void ExtractMeshChunk(const FMaVoxelData& Voxels, const FIntVector& ChunkCoord, FVoxelSurfaceChunk& Chunk);
+			void AssembleResultMesh(const TArray<FIntVector>& DirtyChunks, bool bRebuildAll);
+			void BuildSectionMeshes(const TArray<FIntVector>& DirtyChunks);
+
+			// 平滑模型（固定的顶点保持不动）
+			void SmoothGeneratedMesh(FDynamicMesh3& Mesh, int32 Iterations, const TArray<bool>& FixedVertices);
 
 		};
 	}
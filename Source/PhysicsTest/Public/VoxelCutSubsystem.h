@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "VoxelCutSubsystem.generated.h"
+
+class UVoxelCutComponent;
+
+// 场景内全部切削目标的统一调度
+// 每帧先对各组件的刀具与目标包围盒做宽相位检测，只有重叠时才产生切削请求；
+// 各组件在 Tick 中提交的后台任务（初始化、体素更新、网格生成）先排队，帧末按目标优先级
+// （屏幕尺寸，没有视点时按刀具距离）排序后作为一批提交到任务系统；
+// 任务完成回调中提交的后续阶段和因并发上限排队的任务在槽位空出时立即提交，阶段之间不会多等一帧。
+// 同时运行的任务数受 p.Voxel.MaxConcurrentCutJobs 限制，工件很多时不会挤占整个线程池
+UCLASS()
+class PHYSICSTEST_API UVoxelCutSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// 组件在 BeginPlay / EndPlay 时注册和注销，注册后由子系统推进，组件自身不再 Tick
+	void RegisterCutComponent(UVoxelCutComponent* Component);
+	void UnregisterCutComponent(UVoxelCutComponent* Component);
+
+	// 提交一个后台任务：子系统 Tick 期间提交的在本帧末与其他目标的任务一起调度，其他时候有空闲槽位就立即开始
+	void EnqueueJob(UVoxelCutComponent* Owner, TUniqueFunction<void()> Job);
+
+	UFUNCTION(BlueprintCallable, Category = "Voxel Cut")
+	int32 GetNumCutTargets() const { return CutComponents.Num(); }
+
+	UFUNCTION(BlueprintCallable, Category = "Voxel Cut")
+	int32 GetNumQueuedJobs() const { return QueuedJobs.Num(); }
+
+	UFUNCTION(BlueprintCallable, Category = "Voxel Cut")
+	int32 GetNumRunningJobs() const { return RunningJobs->GetValue(); }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FQueuedJob
+	{
+		TWeakObjectPtr<UVoxelCutComponent> Owner;
+		TUniqueFunction<void()> Work;
+		uint64 Sequence = 0;     // 提交顺序，同一目标的任务保持先后
+		float Priority = 0.0f;
+	};
+
+	// 已注册的切削组件（组件本身由所属 Actor 持有）
+	TArray<TWeakObjectPtr<UVoxelCutComponent>> CutComponents;
+
+	TArray<FQueuedJob> QueuedJobs;
+	uint64 NextJobSequence = 0;
+
+	// 正在推进各组件，此时提交的任务等到帧末批量排序
+	bool bTickingComponents = false;
+
+	// 正在运行的任务数，任务结束时在工作线程上递减，子系统销毁后任务仍可安全访问
+	TSharedRef<FThreadSafeCounter, ESPMode::ThreadSafe> RunningJobs = MakeShared<FThreadSafeCounter, ESPMode::ThreadSafe>();
+
+	// 目标的调度优先级，越大越先执行
+	float ComputePriority(const UVoxelCutComponent* Component, const FVector* ViewLocation) const;
+
+	// 按优先级提交排队的任务，直到达到并发上限
+	void LaunchQueuedJobs();
+	int32 GetMaxConcurrentJobs() const;
+};
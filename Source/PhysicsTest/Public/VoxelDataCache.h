@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MaVoxelData.h"
+
+// 体素数据磁盘缓存
+// 体素数据建立在目标局部空间，只取决于目标网格、精度参数（已按目标缩放换算）和体素化方法，以这些输入的哈希为键保存在 Saved/VoxelCache 下。
+// 文件为定长文件头 + 砖块索引表 + 砖块坐标 + 量化步长 + 砖块池，全部按内存布局原样存放，
+// 加载时内存映射文件后按段整体复制，不需要解析或逐砖块分配；索引表会整体校验后才使用
+struct PHYSICSTEST_API FVoxelDataCache
+{
+	// 文件格式或体素化算法改变时递增，旧缓存自动失效
+	static constexpr uint32 FormatVersion = 3;
+
+	// 计算缓存键（输入的 SHA1）
+	static FString ComputeKey(const FDynamicMesh3& Mesh, const FMaVoxelData& Params, EVoxelizeMethod Method);
+
+	static FString GetCacheFilePath(const FString& Key);
+
+	// 读取缓存，文件不存在或与键、版本不符时返回 false
+	static bool Load(const FString& Key, FMaVoxelData& OutData);
+
+	// 写入缓存（先写临时文件再改名，避免留下不完整的文件）
+	static bool Save(const FString& Key, const FMaVoxelData& Data);
+};
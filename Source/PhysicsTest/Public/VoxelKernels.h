@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelToolShape.h"
+
+// 砖块级别的热点内核
+// 有 ISPC 时使用 VoxelKernels.ispc 中的实现，否则（或 p.Voxel.ISPC 关闭时）使用标量实现，结果在浮点误差内一致
+namespace VoxelKernels
+{
+	// 不在任何刀具位姿范围内的体素的刀具距离
+	constexpr float ToolNotCovered = TNumericLimits<float>::Max();
+
+	PHYSICSTEST_API bool IsISPCEnabled();
+
+	// 三线性插值：Corners 为 8 组按 SoA 排列的角点（X 最快、Z 最慢），组间隔 CornerStride，各数组 16 字节对齐
+	PHYSICSTEST_API void TrilinearBatch(const float* Corners, int32 CornerStride, const float* U, const float* V, const float* W,
+										float* Out, int32 Count);
+
+	// 最小值和最大值（Count 至少为 1）
+	PHYSICSTEST_API void BrickMinMax(const float* Values, int32 Count, float& OutMin, float& OutMax);
+
+	// 目标距离与刀具距离的布尔运算，原地写回 Target，返回被修改的体素数。
+	// Tool 为 ToolNotCovered 的体素到刀具的距离至少为 OutsideDistance
+	PHYSICSTEST_API int32 ApplyCSG(float* Target, const float* Tool, int32 Count,
+								   EVoxelCSGOperation Operation, float Smoothness, float OutsideDistance);
+
+	// 单个体素的布尔运算（标量）
+	PHYSICSTEST_API float ApplyCSGScalar(EVoxelCSGOperation Operation, float Target, float Tool, float Smoothness);
+}
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MaVoxelData.h"
+
+namespace UE
+{
+	namespace Geometry
+	{
+		// 单个网格分块的提取结果
+		struct PHYSICSTEST_API FVoxelSurfaceChunk
+		{
+			TArray<FVector3d> Vertices;
+			TArray<int64> VertexKeys;       // 顶点所在单元的全局编号，用于跨分块焊接
+			TArray<bool> FixedVertices;     // 与相邻分块共享的顶点（平滑时保持不动）
+			TArray<FVector3d> NormalSums;   // 面积加权法线和，接缝顶点焊接后累加
+			TArray<FIndex3i> Triangles;
+		};
+
+		// 稀疏表面网格提取器（Surface Nets）
+		// 网格格点取体素网格中每隔 Stride 个采样点的位置，角点值直接从砖块体素数组读取；
+		// 只遍历跨越等值面的砖块，内部和外部的均匀区域直接跳过
+		class PHYSICSTEST_API FVoxelSurfaceMesher
+		{
+		public:
+			void Initialize(const FMaVoxelData& Voxels, int32 InChunkBricks);
+			bool IsInitialized() const { return ChunkDims.X > 0; }
+
+			FIntVector GetChunkDims() const { return ChunkDims; }
+			int32 GetNumChunks() const { return ChunkDims.X * ChunkDims.Y * ChunkDims.Z; }
+			int32 GetChunkIndex(const FIntVector& ChunkCoord) const
+			{
+				return (ChunkCoord.Z * ChunkDims.Y + ChunkCoord.Y) * ChunkDims.X + ChunkCoord.X;
+			}
+
+			// 收集全部分块 / 与指定范围相交的分块（已包含格点修改影响到的相邻单元）
+			void GetAllChunks(TArray<FIntVector>& OutChunks) const;
+			void GetChunksInBounds(const FAxisAlignedBox3d& InBounds, TArray<FIntVector>& OutChunks) const;
+
+			// 提取一个分块时需要读取的砖块范围（闭区间）
+			void GetChunkBrickRange(const FIntVector& ChunkCoord, FIntVector& OutBrickMin, FIntVector& OutBrickMax) const;
+
+			// 提取一个分块的表面，三角形已按外法线方向定向
+			void ExtractChunk(const FMaVoxelData& Voxels, const FIntVector& ChunkCoord, FVoxelSurfaceChunk& OutChunk) const;
+
+		private:
+			int32 Stride = 1;                                 // 格点间隔（体素数），整除砖块尺寸
+			int32 ChunkCells = 0;                             // 每个分块每边的单元数
+			FIntVector LatticeDims = FIntVector::ZeroValue;   // 格点数量
+			FIntVector CellDims = FIntVector::ZeroValue;      // 单元数量
+			FIntVector ChunkDims = FIntVector::ZeroValue;     // 分块数量
+			FVector3d Origin = FVector3d::Zero();
+			double CellSize = 0.0;
+		};
+	}
+}
@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DynamicMesh/DynamicMesh3.h"
+
+using namespace UE::Geometry;
+
+// 刀具有符号距离场，在刀具局部空间中预先烘焙成规则网格
+// 刀具是刚体，切削时只需把体素位置逆变换到局部空间后做三线性插值
+struct PHYSICSTEST_API FVoxelToolSDF
+{
+	// 每轴最大采样数，避免超大刀具占用过多内存
+	static constexpr int32 MaxSamplesPerAxis = 256;
+
+	FAxisAlignedBox3d Bounds;                    // 采样网格覆盖的局部空间范围
+	FAxisAlignedBox3d MeshBounds;                // 刀具网格本身的局部空间边界
+	double CellSize = 0.0;
+	FIntVector Dims = FIntVector::ZeroValue;     // 每轴采样数
+	TArray<float> Values;
+
+	bool IsValid() const { return Values.Num() > 0; }
+
+	// 烘焙距离场：Padding 为网格边界外额外覆盖的距离
+	bool Build(const FDynamicMesh3& ToolMesh, double InCellSize, double Padding, FProgressCancel* Progress = nullptr);
+
+	// 局部空间采样，网格外的点返回到网格边界的距离加上边界处的值
+	float Sample(const FVector3d& LocalPos) const;
+
+	// 刀具在世界空间中的边界
+	FAxisAlignedBox3d GetWorldBounds(const FTransform& ToolTransform) const { return FAxisAlignedBox3d(MeshBounds, ToolTransform); }
+};
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BoxTypes.h"
+#include "VoxelToolShape.generated.h"
+
+// 刀具形状类型
+UENUM(BlueprintType)
+enum class EVoxelToolShapeType : uint8
+{
+	Mesh,       // 使用刀具网格（CutToolMesh）
+	Sphere,     // 球
+	Capsule,    // 胶囊（球头铣刀）
+	Cylinder,   // 圆柱（平底铣刀，CornerRadius > 0 时为圆角铣刀）
+	Box,        // 长方体
+	Torus       // 圆环
+};
+
+// 刀具作用到目标上的布尔运算（基于有符号距离）
+UENUM(BlueprintType)
+enum class EVoxelCSGOperation : uint8
+{
+	Subtract,         // 切除：max(目标, -刀具)
+	Union,            // 堆积：min(目标, 刀具)
+	Intersect,        // 求交：max(目标, 刀具)，只保留刀具内部的部分
+	SmoothSubtract,   // 平滑切除，切口边缘按 Smoothness 圆滑过渡
+	SmoothUnion       // 平滑堆积
+};
+
+// 参数化刀具描述，在刀具局部空间中定义，刀具轴沿局部 Z 轴
+USTRUCT(BlueprintType)
+struct PHYSICSTEST_API FVoxelToolShape
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	EVoxelToolShapeType Type = EVoxelToolShapeType::Mesh;
+
+	// 形状中心（局部空间）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	FVector Center = FVector::ZeroVector;
+
+	// 半径（球、胶囊、圆柱）或圆环主半径
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut", meta = (ClampMin = "0"))
+	float Radius = 5.0f;
+
+	// 沿 Z 轴的半长（胶囊为两端球心间距的一半）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut", meta = (ClampMin = "0"))
+	float HalfHeight = 10.0f;
+
+	// 圆柱圆角半径 / 圆环管半径
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut", meta = (ClampMin = "0"))
+	float CornerRadius = 0.0f;
+
+	// 长方体半尺寸
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Cut")
+	FVector BoxExtent = FVector(5.0f);
+
+	bool IsAnalytic() const { return Type != EVoxelToolShapeType::Mesh; }
+
+	// 局部空间有符号距离（内部为负）
+	double Evaluate(const FVector3d& LocalPos) const;
+
+	// 局部空间边界
+	UE::Geometry::FAxisAlignedBox3d GetLocalBounds() const;
+};